@@ -0,0 +1,315 @@
+#include "ansi.h"
+
+bool ansiInit( AnsiTerm * t, int fd, int cols ) {
+	t->buf = malloc( ANSI_INITIAL_CAP );
+	if( !t->buf ) {
+		errLog( "ansiInit(): malloc() failed on the frame buffer." );
+		return false;
+	}
+	t->cap = ANSI_INITIAL_CAP;
+	t->len = 0;
+	t->lost = false;
+	t->fd = fd;
+	t->cols = 0;
+
+	int fg, bg;
+	for( fg = 0; fg < N_COLORS * N_COLORS + 1; fg++ ) {
+		t->pair_fg[fg] = -1;
+		t->pair_bg[fg] = -1;
+	}
+	for( fg = 0; fg < N_COLORS; fg++ ) {
+		for( bg = 0; bg < N_COLORS; bg++ ) {
+			int pair = col_map[fg][bg];
+			if( pair > 0 && pair <= N_COLORS * N_COLORS ) {
+				t->pair_fg[pair] = (signed char)fg;
+				t->pair_bg[pair] = (signed char)bg;
+			}
+		}
+	}
+
+	t->n_frames = 0;
+	t->n_writes = 0;
+	t->n_bytes = 0;
+	ansiClear( t, cols );
+	return true;
+}
+
+void ansiFree( AnsiTerm * t ) {
+	free( t->buf );
+	t->buf = NULL;
+	t->len = 0;
+	t->cap = 0;
+}
+
+// Make room for n more bytes. If there is none to be had, the frame is marked as incomplete.
+static bool ansiReserve( AnsiTerm * t, size_t n ) {
+	if( t->len + n <= t->cap ) {
+		return true;
+	}
+	size_t cap = t->cap;
+	while( cap < t->len + n ) {
+		cap *= 2;
+	}
+	char * grown = realloc( t->buf, cap );
+	if( !grown ) {
+		errLog( "ansiReserve(): realloc() failed at %zu bytes.", cap );
+		t->lost = true;
+		return false;
+	}
+	t->buf = grown;
+	t->cap = cap;
+	return true;
+}
+
+static int ansiDigits( int n ) {
+	int d = 1;
+	while( n >= 10 ) {
+		n /= 10;
+		d++;
+	}
+	return d;
+}
+
+// Append n, in decimal. The caller has made room.
+static void ansiPutNum( AnsiTerm * t, int n ) {
+	int d = ansiDigits( n );
+	int i;
+	for( i = d - 1; i >= 0; i-- ) {
+		t->buf[ t->len + i ] = (char)( '0' + n % 10 );
+		n /= 10;
+	}
+	t->len += d;
+}
+
+// Bytes taken by a relative move of 'n' cells along one axis: ESC [ n C, leaving out n when it is 1.
+static int ansiRelLen( int n ) {
+	if( n == 0 ) {
+		return 0;
+	}
+	if( n < 0 ) {
+		n = -n;
+	}
+	return n == 1 ? 3 : 3 + ansiDigits( n );
+}
+
+// Append a relative move of n cells, with 'fwd' as the final byte for positive n and 'back' for negative n.
+static void ansiPutRel( AnsiTerm * t, int n, char fwd, char back ) {
+	if( n == 0 ) {
+		return;
+	}
+	t->buf[ t->len++ ] = '\x1b';
+	t->buf[ t->len++ ] = '[';
+	char final = fwd;
+	if( n < 0 ) {
+		n = -n;
+		final = back;
+	}
+	if( n > 1 ) {
+		ansiPutNum( t, n );
+	}
+	t->buf[ t->len++ ] = final;
+}
+
+/* Put the cursor at x,y, the cheapest way there is: not at all, a
+   backspace, a carriage return, relative moves, or an absolute one. */
+static bool ansiMove( AnsiTerm * t, int y, int x ) {
+	if( t->cx == x && t->cy == y ) {
+		return true;
+	}
+	if( !ansiReserve( t, 32 ) ) {
+		return false;
+	}
+
+	int abs_len = 4 + ansiDigits( y + 1 ) + ansiDigits( x + 1 );
+	if( t->cy >= 0 ) {
+		int dy = y - t->cy;
+		int dx = x - t->cx;
+		int rel_len = ansiRelLen( dy ) + ( dx == -1 ? 1 : ansiRelLen( dx ) );
+		int cr_len = 1 + ansiRelLen( dy );
+		if( x == 0 && cr_len <= rel_len && cr_len < abs_len ) {
+			t->buf[ t->len++ ] = '\r';
+			ansiPutRel( t, dy, 'B', 'A' );
+			t->cx = x;
+			t->cy = y;
+			return true;
+		}
+		if( rel_len < abs_len ) {
+			ansiPutRel( t, dy, 'B', 'A' );
+			if( dx == -1 ) {
+				t->buf[ t->len++ ] = '\b';
+			}
+			else {
+				ansiPutRel( t, dx, 'C', 'D' );
+			}
+			t->cx = x;
+			t->cy = y;
+			return true;
+		}
+	}
+
+	t->buf[ t->len++ ] = '\x1b';
+	t->buf[ t->len++ ] = '[';
+	ansiPutNum( t, y + 1 );
+	t->buf[ t->len++ ] = ';';
+	ansiPutNum( t, x + 1 );
+	t->buf[ t->len++ ] = 'H';
+	t->cx = x;
+	t->cy = y;
+	return true;
+}
+
+// Append one SGR parameter, after a separator if it is not the first.
+static void ansiPutParam( AnsiTerm * t, int n, bool * first ) {
+	if( *first ) {
+		t->buf[ t->len++ ] = '\x1b';
+		t->buf[ t->len++ ] = '[';
+		*first = false;
+	}
+	else {
+		t->buf[ t->len++ ] = ';';
+	}
+	ansiPutNum( t, n );
+}
+
+// Bring the terminal's colors and attributes in line with 'attr', sending only what differs.
+static bool ansiAttr( AnsiTerm * t, attr_t attr ) {
+	int pair = PAIR_NUMBER( attr );
+	if( pair < 0 || pair > N_COLORS * N_COLORS ) {
+		pair = 0;
+	}
+	int fg = t->pair_fg[pair];
+	int bg = t->pair_bg[pair];
+	bool bold = ( attr & A_BOLD ) != 0;
+	bool blink = ( attr & A_BLINK ) != 0;
+
+	if( fg == t->fg && bg == t->bg && bold == t->bold && blink == t->blink ) {
+		return true;
+	}
+	if( !ansiReserve( t, 24 ) ) {
+		return false;
+	}
+
+	bool first = true;
+	if( bold != t->bold ) {
+		ansiPutParam( t, bold ? 1 : 22, &first );
+	}
+	if( blink != t->blink ) {
+		ansiPutParam( t, blink ? 5 : 25, &first );
+	}
+	if( fg != t->fg ) {
+		ansiPutParam( t, fg < 0 ? 39 : 30 + fg, &first );
+	}
+	if( bg != t->bg ) {
+		ansiPutParam( t, bg < 0 ? 49 : 40 + bg, &first );
+	}
+	t->buf[ t->len++ ] = 'm';
+
+	t->fg = fg;
+	t->bg = bg;
+	t->bold = bold;
+	t->blink = blink;
+	return true;
+}
+
+// One printable byte at the cursor, which then moves on.
+static void ansiPutByte( AnsiTerm * t, int ch ) {
+	if( ch < ' ' || ch > '~' ) {
+		ch = '?';
+	}
+	t->buf[ t->len++ ] = (char)ch;
+	t->cx++;
+	// At the right edge, terminals differ on where the cursor goes next.
+	if( t->cols > 0 && t->cx >= t->cols ) {
+		t->cx = -1;
+		t->cy = -1;
+	}
+}
+
+/* Blank the screen and forget everything about the terminal's state, which
+   is then set to the defaults. 'cols' is the terminal width, if it is
+   known (it changes on a resize); otherwise the last one given is kept. */
+void ansiClear( AnsiTerm * t, int cols ) {
+	if( cols > 0 ) {
+		t->cols = cols;
+	}
+	t->cx = -1;
+	t->cy = -1;
+	t->fg = -1;
+	t->bg = -1;
+	t->bold = false;
+	t->blink = false;
+
+	static const char clear[] = "\x1b[0m\x1b[2J";
+	if( ansiReserve( t, sizeof(clear) - 1 ) ) {
+		memcpy( t->buf + t->len, clear, sizeof(clear) - 1 );
+		t->len += sizeof(clear) - 1;
+	}
+}
+
+// Put the terminal's own colors and attributes back.
+void ansiResetAttr( AnsiTerm * t ) {
+	ansiAttr( t, A_NORMAL );
+}
+
+// Draw n cells from x,y to the right, each with the attributes in its chtype.
+void ansiPut( AnsiTerm * t, int y, int x, const chtype * s, int n ) {
+	if( !ansiMove( t, y, x ) ) {
+		return;
+	}
+	int i;
+	for( i = 0; i < n; i++ ) {
+		if( !ansiAttr( t, s[i] & A_ATTRIBUTES ) || !ansiReserve( t, 1 ) ) {
+			return;
+		}
+		ansiPutByte( t, (int)( s[i] & A_CHARTEXT ) );
+	}
+}
+
+// Draw a string from x,y to the right, all in the same attributes.
+void ansiText( AnsiTerm * t, int y, int x, attr_t attr, const char * s ) {
+	size_t n = strlen( s );
+	if( !ansiMove( t, y, x ) || !ansiAttr( t, attr ) || !ansiReserve( t, n ) ) {
+		return;
+	}
+	size_t i;
+	for( i = 0; i < n; i++ ) {
+		ansiPutByte( t, (unsigned char)s[i] );
+	}
+}
+
+/* Send the frame to the terminal, in one write() unless the terminal takes
+   less. Returns false if some of it was lost, along the way or before, in
+   which case the screen is not what the caller thinks it is. */
+bool ansiFlush( AnsiTerm * t ) {
+	bool ok = !t->lost;
+	size_t off = 0;
+	while( off < t->len ) {
+		ssize_t n = write( t->fd, t->buf + off, t->len - off );
+		if( n < 0 ) {
+			if( errno == EINTR ) {
+				continue;
+			}
+			errLog( "ansiFlush(): write() failed after %zu of %zu bytes.", off, t->len );
+			ok = false;
+			break;
+		}
+		off += (size_t)n;
+		t->n_writes++;
+	}
+	if( t->len > 0 ) {
+		t->n_frames++;
+		t->n_bytes += off;
+	}
+	t->len = 0;
+	t->lost = false;
+	return ok;
+}
+
+void ansiLogStats( AnsiTerm * t ) {
+	if( t->n_frames == 0 ) {
+		return;
+	}
+	errInfo( "ANSI output: %llu frames, %llu writes, %llu bytes (%.1f a frame).",
+		(unsigned long long)t->n_frames, (unsigned long long)t->n_writes, (unsigned long long)t->n_bytes,
+		(double)t->n_bytes / t->n_frames );
+}
@@ -0,0 +1,65 @@
+#ifndef ANSI_H
+#define ANSI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "curses.h"
+#include "curses_wrapper.h"
+#include "error_handler.h"
+
+
+/* Raw ANSI terminal output, for drawing without Curses in the way. A frame
+   is put together in one byte buffer, which is kept from frame to frame, and
+   ansiFlush() hands it to the terminal with a single write().
+
+   The writer keeps track of where the terminal's cursor is and which colors
+   and attributes are in effect, so it only sends a cursor move when the next
+   cell is not where the cursor already is (picking the shortest of the
+   absolute and relative moves), and only sends the parts of an SGR sequence
+   that change. Cells are given as chtypes, colors as the color pairs set up
+   by curses_init_color_pairs(), so the same glyphs can go to either Curses or
+   here.
+
+   After anything else writes to the terminal, ansiClear() starts again from a
+   blank screen with nothing assumed. */
+
+#define ANSI_INITIAL_CAP 4096
+
+typedef struct AnsiTerm_t {
+	int fd;
+	int cols;				// Terminal width, or 0 if not known.
+
+	char * buf;
+	size_t len;
+	size_t cap;
+	bool lost;				// Something did not fit in the buffer this frame.
+
+	// Terminal state once the buffer is written. The cursor is -1,-1 when not known.
+	int cx, cy;
+	int fg, bg;				// Curses color numbers, or -1 for the terminal's own.
+	bool bold, blink;
+
+	// Colors of each color pair, worked out from col_map.
+	signed char pair_fg[N_COLORS * N_COLORS + 1];
+	signed char pair_bg[N_COLORS * N_COLORS + 1];
+
+	uint64_t n_frames;
+	uint64_t n_writes;
+	uint64_t n_bytes;
+} AnsiTerm;
+
+bool ansiInit( AnsiTerm * t, int fd, int cols );
+void ansiFree( AnsiTerm * t );
+void ansiClear( AnsiTerm * t, int cols );
+void ansiResetAttr( AnsiTerm * t );
+void ansiPut( AnsiTerm * t, int y, int x, const chtype * s, int n );
+void ansiText( AnsiTerm * t, int y, int x, attr_t attr, const char * s );
+bool ansiFlush( AnsiTerm * t );
+void ansiLogStats( AnsiTerm * t );
+
+#endif
@@ -0,0 +1,402 @@
+#include "arena.h"
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+// Cells of tile t that are inside the arena. Tiles on the right and bottom edges may be cut short.
+static int tileWidth( Arena * arena, int t ) {
+	int x = ( t % arena->grid.tw ) << TILE_SHIFT;
+	return arena->w - x < TILE_SIZE ? arena->w - x : TILE_SIZE;
+}
+
+static int tileHeight( Arena * arena, int t ) {
+	int y = ( t / arena->grid.tw ) << TILE_SHIFT;
+	return arena->h - y < TILE_SIZE ? arena->h - y : TILE_SIZE;
+}
+
+// Set bit i of a word for every cell of the tile's row that is past the arena's edge.
+static uint64_t edgeBits( int tile_w ) {
+	return tile_w == TILE_SIZE ? 0 : ~0ULL << tile_w;
+}
+
+// Index of the n'th clear bit of 'word', counting from bit 0. Halves the
+// window each step; with BMI2, one PDEP does the same.
+static int selectClear( uint64_t word, int n ) {
+	uint64_t clear = ~word;
+#ifdef __BMI2__
+	return __builtin_ctzll( _pdep_u64( 1ULL << n, clear ) );
+#else
+	int bit = 0;
+	int width;
+	for( width = TILE_SIZE / 2; width > 0; width >>= 1 ) {
+		int below = __builtin_popcountll( clear & ( ( 1ULL << width ) - 1 ) );
+		if( n >= below ) {
+			n -= below;
+			clear >>= width;
+			bit += width;
+		}
+	}
+	return bit;
+#endif
+}
+
+// Tile t's checksum, in the word after its bitboard.
+#define arenaTileSum( arena, t ) ( arenaBits( arena, t )[TILE_SIZE] )
+// Tile t's count of non-empty cells, after its checksum. Reads as zero in a blank tile.
+#define arenaTileUsed( arena, t ) ( arenaBits( arena, t )[ TILE_SIZE + 1 ] )
+#define ARENA_TILE_EXTRA ( sizeof(uint64_t) * ( TILE_SIZE + 2 ) )
+
+// What a cell adds to its tile's checksum (SplitMix64's finalizer). Empty cells add nothing.
+static uint64_t cellSum( int cell, int kind ) {
+	if( kind == CELL_EMPTY ) {
+		return 0;
+	}
+	uint64_t z = ( (uint64_t)cell << 32 | (uint32_t)kind ) + 0x9E3779B97F4A7C15ULL;
+	z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+	z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+	return z ^ ( z >> 31 );
+}
+
+// Set up the bitboard of a tile that has just been given memory. Only cells past the edge are taken.
+static void bitsInit( Arena * arena, int t ) {
+	uint64_t * rows = arenaBits( arena, t );
+	int th = tileHeight( arena, t );
+	uint64_t edge = edgeBits( tileWidth( arena, t ) );
+	int y;
+	for( y = 0; y < TILE_SIZE; y++ ) {
+		rows[y] = y < th ? edge : ~0ULL;
+	}
+	arenaTileSum( arena, t ) = 0;
+	arenaTileUsed( arena, t ) = 0;
+}
+
+// Turn the counts in tree[0..len-1] into a Fenwick tree of them, in place. Slot i holds node i + 1.
+static void fenwickBuild( long long * tree, int len ) {
+	int i;
+	for( i = 1; i <= len; i++ ) {
+		int parent = i + ( i & -i );
+		if( parent <= len ) {
+			tree[ parent - 1 ] += tree[ i - 1 ];
+		}
+	}
+}
+
+static void fenwickAdd( long long * tree, int len, int slot, long long delta ) {
+	int i;
+	for( i = slot + 1; i <= len; i += i & -i ) {
+		tree[ i - 1 ] += delta;
+	}
+}
+
+// Find the slot holding count number *n, and take the counts before it off *n.
+// 'step' is the largest power of two not above len.
+static int fenwickFind( const long long * tree, int len, int step, long long * n ) {
+	int pos = 0;
+	for( ; step > 0; step >>= 1 ) {
+		if( pos + step <= len && tree[ pos + step - 1 ] <= *n ) {
+			pos += step;
+			*n -= tree[ pos - 1 ];
+		}
+	}
+	return pos;
+}
+
+// Rebuild the free trees for an all-empty arena, just after gridClear() has given it fresh nodes.
+static void freeTreeReset( Arena * arena ) {
+	TileNode * dir = arena->grid.dir;
+	long long * dir_tree = gridNodeExtra( dir );
+	int gi, ci, i;
+	for( gi = 0; gi < dir->len; gi++ ) {
+		TileNode * group = dir->kids[gi];
+		long long * group_tree = gridNodeExtra( group );
+		dir_tree[gi] = 0;
+		for( ci = 0; ci < group->len; ci++ ) {
+			TileNode * chunk = group->kids[ci];
+			long long * tree = gridNodeExtra( chunk );
+			int t0 = ( ( gi << TILE_NODE_SHIFT ) + ci ) << TILE_NODE_SHIFT;
+			group_tree[ci] = 0;
+			for( i = 0; i < chunk->len; i++ ) {
+				tree[i] = tileWidth( arena, t0 + i ) * tileHeight( arena, t0 + i );
+				group_tree[ci] += tree[i];
+			}
+			fenwickBuild( tree, chunk->len );
+			dir_tree[gi] += group_tree[ci];
+		}
+		fenwickBuild( group_tree, group->len );
+	}
+	fenwickBuild( dir_tree, dir->len );
+	arena->n_free = (long long)arena->w * arena->h;
+}
+
+// Tile t's memory and the nodes above it must be this arena's own (see gridPut()).
+static void freeTreeAdd( Arena * arena, int t, int delta ) {
+	TileGrid * g = &arena->grid;
+	TileNode * chunk = gridChunk( g, t );
+	TileNode * group = gridGroup( g, t );
+	fenwickAdd( gridNodeExtra( chunk ), chunk->len, t & TILE_NODE_MASK, delta );
+	fenwickAdd( gridNodeExtra( group ), group->len, ( t >> TILE_NODE_SHIFT ) & TILE_NODE_MASK, delta );
+	fenwickAdd( gridNodeExtra( g->dir ), g->dir->len, t >> ( 2 * TILE_NODE_SHIFT ), delta );
+	arena->n_free += delta;
+}
+
+// Find the tile holding empty cell number *n, counting across tiles in order.
+// On return, *n is the number of that cell within the tile.
+static int freeTreeFind( Arena * arena, long long * n ) {
+	TileNode * dir = arena->grid.dir;
+	int gi = fenwickFind( gridNodeExtra( dir ), dir->len, arena->free_step, n );
+	TileNode * group = dir->kids[gi];
+	int ci = fenwickFind( gridNodeExtra( group ), group->len, TILE_NODE, n );
+	TileNode * chunk = group->kids[ci];
+	int i = fenwickFind( gridNodeExtra( chunk ), chunk->len, TILE_NODE, n );
+	return ( ( ( gi << TILE_NODE_SHIFT ) + ci ) << TILE_NODE_SHIFT ) + i;
+}
+
+bool arenaInit( Arena * arena, int w, int h ) {
+	if( w < 1 || h < 1 ) {
+		errLog( "arenaInit(): invalid dimensions (w%d h%d).", w, h );
+		return false;
+	}
+
+	arena->w = w;
+	arena->h = h;
+	if( !gridInitExtra( &arena->grid, w, h, CELL_EMPTY, ARENA_TILE_EXTRA, sizeof(long long) ) ) {
+		errLog( "arenaInit(): gridInit() failed on a %dx%d arena.", w, h );
+		return false;
+	}
+
+	arena->free_step = 1;
+	while( arena->free_step * 2 <= arena->grid.dir->len ) {
+		arena->free_step *= 2;
+	}
+
+	// Every cell starts out empty.
+	freeTreeReset( arena );
+
+	arena->n_damage = 0;
+	arena->damage_all = true;
+
+	return true;
+}
+
+// Make 'dst' a copy of 'src' in constant time. They share memory until either one changes.
+// 'dst' must not be set up already.
+bool arenaCopy( Arena * dst, Arena * src ) {
+	*dst = *src;
+	gridCopy( &dst->grid, &src->grid );
+	return true;
+}
+
+void arenaFree( Arena * arena ) {
+	gridFree( &arena->grid );
+	arena->n_free = 0;
+}
+
+/* Bounds checking */
+int inBounds( Arena * arena, int x, int y ) {
+	if( x >= 0 && x <= arena->w - 1 && y >= 0 && y <= arena->h - 1 ) {
+		return 1;
+	}
+	else {
+		return 0;
+	}
+}
+
+int getCell( Arena * arena, int x, int y ) {
+	int kind;
+	if( inBounds( arena, x, y ) ) {
+		kind = gridAt( &arena->grid, x, y );
+	}
+	else {
+		kind = -1;
+	}
+	return kind;
+}
+
+void putCell( Arena * arena, int kind, int x, int y ) {
+	if( inBounds( arena, x, y ) ) {
+		int old = gridAt( &arena->grid, x, y );
+		if( old == kind ) {
+			return;
+		}
+
+		if( !gridPut( &arena->grid, x, y, kind ) ) {
+			errQuit( "FATAL: putCell(): Could not allocate an arena tile." );
+		}
+
+		int t = gridTileIndex( &arena->grid, x, y );
+		uint64_t bit = 1ULL << ( x & TILE_MASK );
+		// gridPut() has given the tile, and the grid nodes above it, memory of their own,
+		// so its bitboard and the free trees can be written.
+		if( old == CELL_EMPTY ) {
+			if( arenaTileUsed( arena, t ) == 0 ) {
+				bitsInit( arena, t );
+			}
+			arenaTileUsed( arena, t )++;
+			arenaBits( arena, t )[ y & TILE_MASK ] |= bit;
+			freeTreeAdd( arena, t, -1 );
+		}
+
+		int cell = gridCellIndex( x, y );
+		arenaTileSum( arena, t ) += cellSum( cell, kind ) - cellSum( cell, old );
+
+		if( kind == CELL_EMPTY ) {
+			arenaBits( arena, t )[ y & TILE_MASK ] &= ~bit;
+			arenaTileUsed( arena, t )--;
+			freeTreeAdd( arena, t, 1 );
+			// Hand the memory back once nothing is left in the tile.
+			if( arenaTileUsed( arena, t ) == 0 ) {
+				gridRelease( &arena->grid, t );
+			}
+		}
+
+		if( arena->n_damage < ARENA_DAMAGE_MAX ) {
+			arena->damage[ arena->n_damage ].x = x;
+			arena->damage[ arena->n_damage ].y = y;
+			arena->n_damage++;
+		}
+		else {
+			arena->damage_all = true;
+		}
+	}
+	return;
+}
+
+void arenaClearDamage( Arena * arena ) {
+	arena->n_damage = 0;
+	arena->damage_all = false;
+}
+
+// Put 'kind' on a random empty cell, every one equally likely.
+// Returns 1 if the arena has no empty cells left.
+int putCellRandom( Arena * arena, int kind, Rng * rng ) {
+	if( arena->n_free == 0 ) {
+		return 1;
+	}
+
+	long long n = (long long)rngBelow( rng, (uint64_t)arena->n_free );
+
+	int t = freeTreeFind( arena, &n );
+	int x0 = ( t % arena->grid.tw ) << TILE_SHIFT;
+	int y0 = ( t / arena->grid.tw ) << TILE_SHIFT;
+	int tw = tileWidth( arena, t );
+	int th = tileHeight( arena, t );
+
+	// A blank tile is all empty, so the cell can be worked out directly.
+	if( gridTileBlank( &arena->grid, t ) ) {
+		putCell( arena, kind, x0 + (int)( n % tw ), y0 + (int)( n / tw ) );
+		return 0;
+	}
+
+	// Otherwise count the empty cells row by row, and pick the bit out of the row it falls in.
+	const uint64_t * rows = arenaBits( arena, t );
+	int y;
+	for( y = 0; y < th; y++ ) {
+		int row_free = __builtin_popcountll( ~rows[y] );
+		if( n < row_free ) {
+			putCell( arena, kind, x0 + selectClear( rows[y], (int)n ), y0 + y );
+			return 0;
+		}
+		n -= row_free;
+	}
+
+	errLog( "putCellRandom(): free count for tile %d is out of step with its cells.", t );
+	return 1;
+}
+
+// Number of empty cells in the rectangle at x,y, w by h. Parts outside the arena are not counted.
+long long arenaCountFree( Arena * arena, int x, int y, int w, int h ) {
+	int x1 = x + w < arena->w ? x + w : arena->w;
+	int y1 = y + h < arena->h ? y + h : arena->h;
+	if( x < 0 ) {
+		x = 0;
+	}
+	if( y < 0 ) {
+		y = 0;
+	}
+
+	long long n = 0;
+	int cy, cx;
+	for( cy = y; cy < y1; cy++ ) {
+		for( cx = x; cx < x1; ) {
+			int t = gridTileIndex( &arena->grid, cx, cy );
+			int run_end = ( ( cx >> TILE_SHIFT ) + 1 ) << TILE_SHIFT;
+			int n_run = ( run_end < x1 ? run_end : x1 ) - cx;
+			if( gridTileBlank( &arena->grid, t ) ) {
+				n += n_run;
+			}
+			else {
+				// n_run bits of the row, starting at cx's bit. A whole row is the one case that needs no mask.
+				uint64_t row = ~arenaBits( arena, t )[ cy & TILE_MASK ] >> ( cx & TILE_MASK );
+				if( n_run < TILE_SIZE ) {
+					row &= ( 1ULL << n_run ) - 1;
+				}
+				n += __builtin_popcountll( row );
+			}
+			cx += n_run;
+		}
+	}
+	return n;
+}
+
+/* A 64-bit digest of every cell in the arena, from the tile checksums (FNV-1a
+   over each tile's number and sum). Costs one step per tile, not per cell.
+   Two arenas with the same size and the same cells always agree on it. */
+uint64_t arenaDigest( Arena * arena ) {
+	uint64_t h = 0xCBF29CE484222325ULL;
+	int n_tiles = arena->grid.tw * arena->grid.th;
+	int t;
+	for( t = 0; t < n_tiles; t++ ) {
+		if( gridTileBlank( &arena->grid, t ) ) {
+			continue;
+		}
+		h = ( h ^ (uint64_t)t ) * 0x100000001B3ULL;
+		h = ( h ^ arenaTileSum( arena, t ) ) * 0x100000001B3ULL;
+	}
+	return h;
+}
+
+/* Lay out a fresh arena. Everything is emptied first, and then only the walls
+   are written, so this costs the length of the walls rather than the area. */
+void arenaMake( Arena * arena, int b_n, int b_s, int b_e, int b_w, int board_type ) {
+	if( !gridClear( &arena->grid, CELL_EMPTY ) ) {
+		errQuit( "FATAL: arenaMake(): Could not clear the arena." );
+	}
+	freeTreeReset( arena );
+	arena->n_damage = 0;
+	arena->damage_all = true;
+
+	int x, y;
+
+	// Plot borders if requested
+	for( x = 0; x < arena->w; x++ ) {
+		if( b_n ) {
+			putCell( arena, CELL_WALL, x, 0 );
+		}
+		if( b_s ) {
+			putCell( arena, CELL_WALL, x, arena->h - 1 );
+		}
+	}
+	for( y = 0; y < arena->h; y++ ) {
+		if( b_w ) {
+			putCell( arena, CELL_WALL, 0, y );
+		}
+		if( b_e ) {
+			putCell( arena, CELL_WALL, arena->w - 1, y );
+		}
+	}
+
+	// Cross pattern: two bars, three cells thick, stopping four cells short of the edges.
+	if( board_type == BOARDTYPE_CROSS ) {
+		for( y = arena->h / 2 - 1; y <= arena->h / 2 + 1; y++ ) {
+			for( x = 4; x < arena->w - 4; x++ ) {
+				putCell( arena, CELL_WALL, x, y );
+			}
+		}
+		for( x = arena->w / 2 - 1; x <= arena->w / 2 + 1; x++ ) {
+			for( y = 4; y < arena->h - 4; y++ ) {
+				putCell( arena, CELL_WALL, x, y );
+			}
+		}
+	}
+}
@@ -0,0 +1,111 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "error_handler.h"
+#include "board.h"			// Coord
+#include "tilegrid.h"
+#include "rng.h"
+
+
+/* Cell IDs */
+#define CELL_EMPTY 0
+#define CELL_WALL 1
+#define CELL_APPLE 2
+#define CELL_SNAKE 100 // 100 or 101, alternating along the body
+
+#define BOARDTYPE_EMPTY 0
+#define BOARDTYPE_CROSS 1
+
+#define ARENA_DAMAGE_MAX 64
+
+// One row of a tile has to fit a bitboard word.
+#if TILE_SIZE != 64
+#error "arena.c: bitboards assume 64-cell tile rows."
+#endif
+
+/* The game grid. Cells live in a TileGrid (see tilegrid.h), so an arena can
+   be enormous: tiles only get memory once something other than CELL_EMPTY is
+   written to them, and go back to the shared blank tile when they are empty
+   again. Memory follows the walls and the ground the Snek has covered, not
+   w * h.
+
+   To pick a random empty cell without keeping a list of every one of them,
+   the arena counts the non-empty cells in each tile, and keeps the number of
+   empty cells under every pointer of the grid's chunks, groups and directory
+   (see tilegrid.h) as a Fenwick tree in each node's slot extras. Finding the
+   tile that holds the n'th empty cell takes log(tiles) steps.
+
+   Within a tile, occupancy is kept as a bitboard: one 64-bit word per tile
+   row, with a bit set for every cell that is not CELL_EMPTY (walls, the Snek
+   and apples alike). Bits past the arena's edge are set too, so the empty
+   cells in a row are always popcount( ~row ). The n'th empty cell of a tile
+   is found by counting row words, then selecting the bit inside one word,
+   rather than by reading every cell. Bitboards live in the extra bytes of
+   each tile (see gridInitExtra()), so they come and go with the tile's
+   memory; a blank tile has none. putCell() keeps the counts and bits current.
+
+   After its bitboard, each tile keeps a checksum of its cells: the sum of
+   a 64-bit mix of every non-empty cell's place and kind, which putCell()
+   adjusts for the one cell it changes. Then comes its count of non-empty
+   cells; a blank tile reads as zero. arenaDigest() combines the sums of
+   the tiles that have memory into one value for the whole arena, without
+   reading any cells.
+
+   arenaCopy() takes constant time. The copy shares the grid with the
+   original, tiles, bitboards and free trees and all, and each side gets its
+   own copy of a tile, and of the nodes on the way to it, the first time it
+   changes it. So a write after a copy costs a few small blocks, not a word
+   per tile.
+
+   putCell() also records which cells changed since the renderer last looked
+   (see render.c). If more than ARENA_DAMAGE_MAX cells change in between,
+   the list is dropped and damage_all is set instead. */
+
+typedef struct Arena_t {
+	int w;
+	int h;
+	TileGrid grid;
+
+	int free_step;			// Largest power of two not above the grid's group count.
+	long long n_free;
+
+	Coord damage[ARENA_DAMAGE_MAX];
+	int n_damage;
+	bool damage_all;
+} Arena;
+
+// Tile t's bitboard, in the tile's extra bytes. Only there while the tile has memory of its own.
+#define arenaBits( arena, t ) ( (uint64_t *)gridTileExtra( &(arena)->grid, t ) )
+
+/* Whether x,y holds anything but CELL_EMPTY: one bit test, without reading
+   the cell. Outside the arena counts as occupied. Walls, the Snek and
+   apples all count, so callers that can walk onto apples only need to read
+   the cell itself when this is true. */
+static inline bool arenaIsOccupied( Arena * arena, int x, int y ) {
+	if( (unsigned)x >= (unsigned)arena->w || (unsigned)y >= (unsigned)arena->h ) {
+		return true;
+	}
+	int t = gridTileIndex( &arena->grid, x, y );
+	if( gridTileBlank( &arena->grid, t ) ) {
+		return false;
+	}
+	return ( arenaBits( arena, t )[ y & TILE_MASK ] >> ( x & TILE_MASK ) ) & 1;
+}
+
+bool arenaInit( Arena * arena, int w, int h );
+bool arenaCopy( Arena * dst, Arena * src );
+void arenaFree( Arena * arena );
+void arenaMake( Arena * arena, int b_n, int b_s, int b_e, int b_w, int board_type );
+
+int inBounds( Arena * arena, int x, int y );
+int getCell( Arena * arena, int x, int y );
+void putCell( Arena * arena, int kind, int x, int y );
+int putCellRandom( Arena * arena, int kind, Rng * rng );
+long long arenaCountFree( Arena * arena, int x, int y, int w, int h );
+uint64_t arenaDigest( Arena * arena );
+void arenaClearDamage( Arena * arena );
+
+#endif
@@ -0,0 +1,267 @@
+#include "autopilot.h"
+
+#define AUTOPILOT_SLOTS ( AUTOPILOT_SEARCH_MAX * 2 )
+
+static const int ap_dirs[4] = { DIR_EAST, DIR_SOUTH, DIR_WEST, DIR_NORTH };
+static const int ap_dx[4] = { 1, 0, -1, 0 };
+static const int ap_dy[4] = { 0, 1, 0, -1 };
+
+bool autopilotInit( Autopilot * ap ) {
+	ap->nodes = malloc( sizeof(Coord) * AUTOPILOT_SEARCH_MAX );
+	ap->parent = malloc( sizeof(int) * AUTOPILOT_SEARCH_MAX );
+	ap->path = malloc( AUTOPILOT_SEARCH_MAX );
+	ap->keys = malloc( sizeof(uint64_t) * AUTOPILOT_SLOTS );
+	ap->stamp = calloc( AUTOPILOT_SLOTS, sizeof(unsigned int) );
+	if( !ap->nodes || !ap->parent || !ap->path || !ap->keys || !ap->stamp ) {
+		errLog( "autopilotInit(): malloc() failed on the search buffers." );
+		autopilotFree( ap );
+		return false;
+	}
+	ap->slot_mask = AUTOPILOT_SLOTS - 1;
+	ap->search_id = 0;
+	ap->n_nodes = 0;
+
+	ap->n_searches = 0;
+	ap->n_reused = 0;
+	ap->n_survival = 0;
+	autopilotReset( ap );
+
+	return true;
+}
+
+void autopilotFree( Autopilot * ap ) {
+	free( ap->nodes );
+	free( ap->parent );
+	free( ap->path );
+	free( ap->keys );
+	free( ap->stamp );
+	ap->nodes = NULL;
+	ap->parent = NULL;
+	ap->path = NULL;
+	ap->keys = NULL;
+	ap->stamp = NULL;
+}
+
+// Forget the stored path, for a new game.
+void autopilotReset( Autopilot * ap ) {
+	ap->path_len = 0;
+	ap->path_pos = 0;
+	ap->retry_tick = 0;
+	ap->retry_wait = AUTOPILOT_RETRY_TICKS;
+}
+
+// Whether the Snek can move onto x,y. Only occupied cells need reading, to tell apples apart.
+static bool apFree( Game * game, int x, int y ) {
+	return !arenaIsOccupied( &game->arena, x, y ) || getCell( &game->arena, x, y ) == CELL_APPLE;
+}
+
+// Start a new search with nothing visited.
+static void apBegin( Autopilot * ap ) {
+	ap->n_nodes = 0;
+	if( ++ap->search_id == 0 ) {
+		memset( ap->stamp, 0, sizeof(unsigned int) * AUTOPILOT_SLOTS );
+		ap->search_id = 1;
+	}
+}
+
+/* Mark x,y as reached from node 'from'. Returns its node number, or -1 if it
+   was reached already or the search is full. */
+static int apVisit( Autopilot * ap, Game * game, int x, int y, int from ) {
+	if( ap->n_nodes == AUTOPILOT_SEARCH_MAX ) {
+		return -1;
+	}
+
+	uint64_t key = (uint64_t)y * game->arena.w + x;
+	int slot = (int)( ( key * 0x9E3779B97F4A7C15ULL ) >> 32 ) & ap->slot_mask;
+	while( ap->stamp[slot] == ap->search_id ) {
+		if( ap->keys[slot] == key ) {
+			return -1;
+		}
+		slot = ( slot + 1 ) & ap->slot_mask;
+	}
+	ap->stamp[slot] = ap->search_id;
+	ap->keys[slot] = key;
+
+	int n = ap->n_nodes++;
+	ap->nodes[n].x = x;
+	ap->nodes[n].y = y;
+	ap->parent[n] = from;
+	return n;
+}
+
+// Number of free cells that can be reached from x,y without going through the head, up to 'cap'.
+static int apRoom( Autopilot * ap, Game * game, int x, int y, int cap ) {
+	apBegin( ap );
+	apVisit( ap, game, game->px, game->py, -1 );
+	apVisit( ap, game, x, y, 0 );
+
+	int i, d;
+	for( i = 1; i < ap->n_nodes && ap->n_nodes - 1 < cap; i++ ) {
+		for( d = 0; d < 4; d++ ) {
+			int nx = ap->nodes[i].x + ap_dx[d];
+			int ny = ap->nodes[i].y + ap_dy[d];
+			if( apFree( game, nx, ny ) ) {
+				apVisit( ap, game, nx, ny, i );
+			}
+		}
+	}
+	return ap->n_nodes - 1;
+}
+
+// Direction index that leads from node 'from' to node 'to', next to each other.
+static int apStepDir( Autopilot * ap, int from, int to ) {
+	int dx = ap->nodes[to].x - ap->nodes[from].x;
+	int dy = ap->nodes[to].y - ap->nodes[from].y;
+	int d;
+	for( d = 0; d < 4; d++ ) {
+		if( ap_dx[d] == dx && ap_dy[d] == dy ) {
+			return d;
+		}
+	}
+	return 0;
+}
+
+/* Search out from the head for the nearest apple, and store the way there.
+   The head's own cell does not count: an apple there is eaten this tick. */
+static bool apFindApple( Autopilot * ap, Game * game ) {
+	apBegin( ap );
+	apVisit( ap, game, game->px, game->py, -1 );
+
+	int i, d;
+	for( i = 0; i < ap->n_nodes; i++ ) {
+		for( d = 0; d < 4; d++ ) {
+			int nx = ap->nodes[i].x + ap_dx[d];
+			int ny = ap->nodes[i].y + ap_dy[d];
+			int kind = arenaIsOccupied( &game->arena, nx, ny ) ? getCell( &game->arena, nx, ny ) : CELL_EMPTY;
+			if( kind != CELL_EMPTY && kind != CELL_APPLE ) {
+				continue;
+			}
+			int n = apVisit( ap, game, nx, ny, i );
+			if( n < 0 || kind != CELL_APPLE ) {
+				continue;
+			}
+
+			// Walk back to the head, writing the directions from the end of the path.
+			int len = 0;
+			int at;
+			for( at = n; ap->parent[at] >= 0; at = ap->parent[at] ) {
+				len++;
+			}
+			int pos = len;
+			for( at = n; ap->parent[at] >= 0; at = ap->parent[at] ) {
+				ap->path[ --pos ] = (unsigned char)apStepDir( ap, ap->parent[at], at );
+			}
+			ap->path_len = len;
+			ap->path_pos = 0;
+			ap->target.x = nx;
+			ap->target.y = ny;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Whether the stored path still leads from where the head is to an apple.
+static bool apPathGood( Autopilot * ap, Game * game ) {
+	if( ap->path_pos >= ap->path_len ) {
+		return false;
+	}
+	if( game->px != ap->expect.x || game->py != ap->expect.y ) {
+		return false;
+	}
+	if( getCell( &game->arena, ap->target.x, ap->target.y ) != CELL_APPLE ) {
+		return false;
+	}
+	int d = ap->path[ ap->path_pos ];
+	return apFree( game, game->px + ap_dx[d], game->py + ap_dy[d] );
+}
+
+// Take direction index d along the stored path.
+static int apFollow( Autopilot * ap, Game * game, int d ) {
+	ap->expect.x = game->px + ap_dx[d];
+	ap->expect.y = game->py + ap_dy[d];
+	return ap_dirs[d];
+}
+
+/* Straight on if there is room enough that way, otherwise the first turn
+   with room enough, otherwise the free neighbour with the most room. Trying
+   straight on first usually settles it with one flood. */
+static int apSurvive( Autopilot * ap, Game * game, int cap ) {
+	int order[4];
+	int n = 0;
+	int d;
+	for( d = 0; d < 4; d++ ) {
+		if( ap_dirs[d] == game->pdir ) {
+			order[ n++ ] = d;
+		}
+	}
+	for( d = 0; d < 4; d++ ) {
+		if( gameCanTurn( game, ap_dirs[d] ) ) {
+			order[ n++ ] = d;
+		}
+	}
+
+	int best = -1;
+	int best_room = -1;
+	int i;
+	for( i = 0; i < n; i++ ) {
+		d = order[i];
+		int nx = game->px + ap_dx[d];
+		int ny = game->py + ap_dy[d];
+		if( !apFree( game, nx, ny ) ) {
+			continue;
+		}
+		int room = apRoom( ap, game, nx, ny, cap );
+		if( room > best_room ) {
+			best = d;
+			best_room = room;
+		}
+		if( room >= cap ) {
+			break;
+		}
+	}
+	return best < 0 ? DIR_NONE : ap_dirs[best];
+}
+
+// The turn for this tick.
+int autopilotNextTurn( Autopilot * ap, Game * game ) {
+	if( game->over ) {
+		return DIR_NONE;
+	}
+
+	if( apPathGood( ap, game ) ) {
+		ap->n_reused++;
+		return apFollow( ap, game, ap->path[ ap->path_pos++ ] );
+	}
+
+	// Enough room for the whole Snek is taken to mean it can get back out.
+	int cap = game->plen + 1 < AUTOPILOT_SEARCH_MAX - 1 ? game->plen + 1 : AUTOPILOT_SEARCH_MAX - 1;
+
+	if( game->tick >= ap->retry_tick ) {
+		ap->n_searches++;
+		if( apFindApple( ap, game ) ) {
+			ap->retry_wait = AUTOPILOT_RETRY_TICKS;
+			int d = ap->path[0];
+			if( apRoom( ap, game, game->px + ap_dx[d], game->py + ap_dy[d], cap ) >= cap ) {
+				ap->path_pos = 1;
+				return apFollow( ap, game, d );
+			}
+		}
+		else if( ap->n_nodes >= AUTOPILOT_RETRY_NODES ) {
+			ap->retry_tick = game->tick + ap->retry_wait;
+			if( ap->retry_wait < AUTOPILOT_RETRY_MAX ) {
+				ap->retry_wait *= 2;
+			}
+		}
+	}
+
+	ap->path_len = 0;
+	ap->path_pos = 0;
+	ap->n_survival++;
+	return apSurvive( ap, game, cap );
+}
+
+void autopilotLogStats( Autopilot * ap ) {
+	errInfo( "Autopilot: %ld searches, %ld ticks on a stored path, %ld survival moves.",
+		ap->n_searches, ap->n_reused, ap->n_survival );
+}
@@ -0,0 +1,80 @@
+#ifndef AUTOPILOT_H
+#define AUTOPILOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "error_handler.h"
+#include "game.h"
+
+
+/* A computer player. autopilotNextTurn() gives the direction for the next
+   tick, the same way inputNextTurn() does for the keyboard, so either one
+   can drive gameStep().
+
+   The autopilot searches breadth-first from the Snek's head, through empty
+   cells only, for the nearest apple, and keeps the path it found. Each
+   tick only moves the head one cell along that path and frees the tail, and
+   neither can block the rest of it, so the path is simply followed until it
+   is used up, its apple has gone, or the cell ahead is no longer free --
+   only then is the search run again. Breadth-first rather than A*, because
+   big arenas have many apples and the nearest one is the goal anyway.
+
+   Visited cells go in a hash set sized for AUTOPILOT_SEARCH_MAX cells,
+   rather than a map of the whole arena, so the cost does not depend on the
+   arena's size; a search that reaches the limit without an apple counts as
+   having found none. Slots are stamped with a search number, so a new search
+   never has to clear the set.
+
+   A search that finds no apple at all is the expensive kind: it goes through
+   every cell it can reach. Apples only appear when one is eaten, and the
+   space around the Snek only opens up as its tail moves on, so another
+   search would most likely fail the same way. After a failed search that
+   went through AUTOPILOT_RETRY_NODES cells or more, the autopilot waits
+   AUTOPILOT_RETRY_TICKS before trying again, twice as long after each
+   failure in a row, up to AUTOPILOT_RETRY_MAX. Smaller searches are cheap
+   enough to run every tick.
+
+   When there is no path, or the first step of the one found leads into a
+   space too small to hold the Snek, the autopilot falls back to survival: it
+   takes the free neighbour with the most room behind it. */
+
+#define AUTOPILOT_SEARCH_MAX (1 << 16)
+#define AUTOPILOT_RETRY_NODES 4096
+#define AUTOPILOT_RETRY_TICKS 16
+#define AUTOPILOT_RETRY_MAX 256
+
+typedef struct Autopilot_t {
+	// Search: cells in the order they were reached, and how each was reached.
+	Coord * nodes;
+	int * parent;
+	int n_nodes;
+
+	// Visited set, open addressing. A slot is in use if its stamp is the current search's.
+	uint64_t * keys;
+	unsigned int * stamp;
+	unsigned int search_id;
+	int slot_mask;
+
+	// The path being followed: directions, and where the head should be before path[pos].
+	unsigned char * path;
+	int path_len;
+	int path_pos;
+	Coord expect;
+	Coord target;
+	unsigned long retry_tick;	// No new search before this tick, after one that failed.
+	int retry_wait;
+
+	long n_searches;
+	long n_reused;			// Ticks that followed the stored path without searching.
+	long n_survival;
+} Autopilot;
+
+bool autopilotInit( Autopilot * ap );
+void autopilotFree( Autopilot * ap );
+void autopilotReset( Autopilot * ap );
+int autopilotNextTurn( Autopilot * ap, Game * game );
+void autopilotLogStats( Autopilot * ap );
+
+#endif
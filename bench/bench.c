@@ -0,0 +1,720 @@
+/* Snek benchmarks
+
+   Times the hot paths of the game at several arena sizes and prints one JSON
+   object per line, so that runs from different versions can be diffed or
+   loaded into a spreadsheet:
+
+     {"bench":"tick","w":23,"h":23,"iters":...,"ns_per_op":...,"ops_per_sec":...,
+      "cells_per_sec":...,"peak_rss_kb":...}
+
+   cells_per_sec is the number of board/arena cells an operation covers
+   (w*h for full-board operations, 1 for single-cell ones) times ops_per_sec.
+   peak_rss_kb is the process high-water mark at the end of that benchmark.
+
+   Usage: snek_bench [--max SIZE] [--only NAME] [--brd FILE]                   */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "curses.h"
+
+#include "error_handler.h"
+#include "curses_wrapper.h"
+#include "draw.h"
+#include "board.h"
+#include "game.h"
+#include "render.h"
+#include "autopilot.h"
+
+// Keep running a benchmark until it has used at least this much time.
+#define BENCH_MIN_NS 250000000.0
+
+// Largest virtual screen used for the draw benchmarks.
+#define BENCH_SCREEN_MAX 1024
+
+// Window used for the render benchmarks: a typical terminal.
+#define BENCH_VIEW_W 80
+#define BENCH_VIEW_H 24
+
+#define BENCH_TMP_FILE "/tmp/snek_bench.brd"
+
+static const int bench_sizes[] = { 23, 64, 256, 1024, 4096 };
+#define N_BENCH_SIZES (int)(sizeof(bench_sizes) / sizeof(bench_sizes[0]))
+#define BENCH_SPARSE_SIZE 100000
+
+static int max_size = 4096;
+static char * only = NULL;
+static char * brd_file = "snek.brd";
+
+static double nowNs( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static long peakRssKb( void ) {
+	struct rusage ru;
+	getrusage( RUSAGE_SELF, &ru );
+	return ru.ru_maxrss;
+}
+
+static bool wanted( char * name ) {
+	return !only || strcmp( only, name ) == 0;
+}
+
+static void report( char * name, int w, int h, long iters, double elapsed_ns, double cells_per_op ) {
+	double ns_per_op = elapsed_ns / iters;
+	double ops_per_sec = 1e9 / ns_per_op;
+
+	printf( "{\"bench\":\"%s\",\"version\":\"%s\",\"w\":%d,\"h\":%d,\"iters\":%ld,"
+		"\"ns_per_op\":%.1f,\"ops_per_sec\":%.1f,\"cells_per_sec\":%.1f,\"peak_rss_kb\":%ld}\n",
+		name, SNEK_VERSION, w, h, iters, ns_per_op, ops_per_sec, ops_per_sec * cells_per_op, peakRssKb() );
+	fflush( stdout );
+}
+
+// Fill a board with printable junk in every color, so nothing compares equal by accident.
+static Board * makeNoiseBoard( int w, int h, unsigned int seed ) {
+	Board * brd = boardInit( w, h, true );
+	if( !brd ) {
+		return NULL;
+	}
+	int x, y;
+	for( x = 0; x < w; x++ ) {
+		for( y = 0; y < h; y++ ) {
+			int pattern = ' ' + rand_r( &seed ) % 95;
+			int fg = rand_r( &seed ) % N_COLORS;
+			int bg = rand_r( &seed ) % N_COLORS;
+			int bright = rand_r( &seed ) % 2;
+			boardPutCell( brd, cellMake( pattern, fg, bg, bright, 0 ), x, y );
+		}
+	}
+	return brd;
+}
+
+/* Steer away from whatever is directly ahead, preferring a right turn. Good
+   enough to keep a Snek alive for a while on an empty arena. */
+static int steer( Game * game ) {
+	static const int dirs[4] = { DIR_EAST, DIR_SOUTH, DIR_WEST, DIR_NORTH };
+	static const int dx[4] = { 1, 0, -1, 0 };
+	static const int dy[4] = { 0, 1, 0, -1 };
+
+	int d;
+	for( d = 0; d < 4; d++ ) {
+		if( dirs[d] == game->pdir ) {
+			break;
+		}
+	}
+	int turn;
+	for( turn = 0; turn < 4; turn++ ) {
+		int nd = (d + turn) % 4;
+		int kind = getCell( &game->arena, game->px + dx[nd], game->py + dy[nd] );
+		if( kind != CELL_WALL && kind < CELL_SNAKE && kind != -1 ) {
+			return dirs[nd];
+		}
+	}
+	return DIR_NONE;
+}
+
+static void benchTick( int size ) {
+	Game game;
+	Rng rng;
+	rngSeed( &rng, 1 );
+	if( !gameInit( &game, size, size, BOARDTYPE_EMPTY, &rng ) ) {
+		return;
+	}
+
+	long iters = 0;
+	double elapsed = 0;
+	while( elapsed < BENCH_MIN_NS ) {
+		double start = nowNs();
+		int i;
+		for( i = 0; i < 10000; i++ ) {
+			if( gameStep( &game, steer( &game ) ) == STEP_GAME_OVER ) {
+				break;
+			}
+		}
+		elapsed += nowNs() - start;
+		iters += i;
+
+		// Restart outside of the timed section.
+		if( game.over ) {
+			gameFree( &game );
+			rngSeed( &rng, iters );
+			if( !gameInit( &game, size, size, BOARDTYPE_EMPTY, &rng ) ) {
+				return;
+			}
+		}
+	}
+	report( "tick", size, size, iters, elapsed, 1 );
+	gameFree( &game );
+}
+
+/* A tick with a snapshot taken before it, as rollback would, keeping the
+   last BENCH_SNAPSHOTS. Compare with "tick": the difference is the cost of
+   gameCopy() plus the tiles, and the tile grid nodes above them, copied
+   when the live game writes to them. It should not grow with the size of
+   the arena; the run at BENCH_SPARSE_SIZE checks that. */
+#define BENCH_SNAPSHOTS 64
+static void benchTickSnapshot( int size ) {
+	Game game;
+	Rng rng;
+	rngSeed( &rng, 1 );
+	if( !gameInit( &game, size, size, BOARDTYPE_EMPTY, &rng ) ) {
+		return;
+	}
+	Game snaps[BENCH_SNAPSHOTS];
+	long taken = 0;
+	int n_snaps = 0;
+	bool ok = true;
+	bool have_game = true;
+
+	long iters = 0;
+	double elapsed = 0;
+	while( ok && elapsed < BENCH_MIN_NS ) {
+		double start = nowNs();
+		int i;
+		for( i = 0; i < 10000; i++ ) {
+			Game * snap = &snaps[ taken % BENCH_SNAPSHOTS ];
+			if( n_snaps == BENCH_SNAPSHOTS ) {
+				gameFree( snap );
+				n_snaps--;
+			}
+			if( !gameCopy( snap, &game ) ) {
+				fprintf( stderr, "tick_snapshot: gameCopy() failed\n" );
+				ok = false;
+				break;
+			}
+			taken++;
+			n_snaps++;
+			if( gameStep( &game, steer( &game ) ) == STEP_GAME_OVER ) {
+				break;
+			}
+		}
+		elapsed += nowNs() - start;
+		iters += i;
+
+		if( game.over ) {
+			gameFree( &game );
+			rngSeed( &rng, iters );
+			if( !gameInit( &game, size, size, BOARDTYPE_EMPTY, &rng ) ) {
+				ok = false;
+				have_game = false;
+			}
+		}
+	}
+	if( ok ) {
+		report( "tick_snapshot", size, size, iters, elapsed, 1 );
+	}
+	if( have_game ) {
+		gameFree( &game );
+	}
+	for( ; n_snaps > 0; n_snaps-- ) {
+		gameFree( &snaps[ ( taken - n_snaps ) % BENCH_SNAPSHOTS ] );
+	}
+}
+
+// Ticks with the autopilot steering, on the cross board. Includes the time spent searching.
+static void benchTickAutopilot( int size ) {
+	Autopilot ap;
+	if( !autopilotInit( &ap ) ) {
+		return;
+	}
+	Game game;
+	Rng rng;
+	rngSeed( &rng, 1 );
+	if( !gameInit( &game, size, size, BOARDTYPE_CROSS, &rng ) ) {
+		autopilotFree( &ap );
+		return;
+	}
+
+	long iters = 0;
+	double elapsed = 0;
+	while( elapsed < BENCH_MIN_NS ) {
+		double start = nowNs();
+		int i;
+		for( i = 0; i < 10000; i++ ) {
+			if( gameStep( &game, autopilotNextTurn( &ap, &game ) ) == STEP_GAME_OVER ) {
+				break;
+			}
+		}
+		elapsed += nowNs() - start;
+		iters += i;
+
+		if( game.over ) {
+			gameFree( &game );
+			autopilotReset( &ap );
+			rngSeed( &rng, iters );
+			if( !gameInit( &game, size, size, BOARDTYPE_CROSS, &rng ) ) {
+				autopilotFree( &ap );
+				return;
+			}
+		}
+	}
+	report( "tick_autopilot", size, size, iters, elapsed, 1 );
+	gameFree( &game );
+	autopilotFree( &ap );
+}
+
+static void benchPutCellRandom( int size ) {
+	Arena arena;
+	if( !arenaInit( &arena, size, size ) ) {
+		return;
+	}
+	arenaMake( &arena, 1, 1, 1, 1, BOARDTYPE_CROSS );
+	Rng rng;
+	rngSeed( &rng, 1 );
+
+	// Never fill more than half of the free space, so every pick succeeds.
+	int batch = arena.n_free / 2 < 10000 ? arena.n_free / 2 : 10000;
+
+	long iters = 0;
+	double elapsed = 0;
+	while( elapsed < BENCH_MIN_NS ) {
+		double start = nowNs();
+		int i;
+		for( i = 0; i < batch; i++ ) {
+			putCellRandom( &arena, CELL_APPLE, &rng );
+		}
+		elapsed += nowNs() - start;
+		iters += batch;
+
+		// Take the apples back off again, outside of the timed section.
+		int x, y;
+		for( x = 0; x < arena.w && i > 0; x++ ) {
+			for( y = 0; y < arena.h && i > 0; y++ ) {
+				if( getCell( &arena, x, y ) == CELL_APPLE ) {
+					putCell( &arena, CELL_EMPTY, x, y );
+					i--;
+				}
+			}
+		}
+	}
+	report( "put_cell_random", size, size, iters, elapsed, 1 );
+	arenaFree( &arena );
+}
+
+static void benchBoardDraw( int size ) {
+	Board * brd = makeNoiseBoard( size, size, 7 );
+	if( !brd ) {
+		return;
+	}
+	resizeterm( size + 2 > BENCH_SCREEN_MAX ? BENCH_SCREEN_MAX : size + 2,
+		size + 2 > BENCH_SCREEN_MAX ? BENCH_SCREEN_MAX : size + 2 );
+
+	Coord offset = { 1, 1 };
+	long iters = 0;
+	double start = nowNs();
+	double elapsed = 0;
+	while( elapsed < BENCH_MIN_NS ) {
+		boardDraw( brd, offset, true );
+		refresh();
+		// Invalidate the screen so that every frame is sent in full.
+		clearok( curscr, TRUE );
+		iters++;
+		elapsed = nowNs() - start;
+	}
+	report( "board_draw", size, size, iters, elapsed, (double)size * size );
+	boardFree( brd );
+}
+
+/* One game tick plus the incremental arena redraw and the Curses refresh
+   that follows it, as the main loop does. With full_redraw set, every frame
+   is repainted from scratch instead, for comparison. The window is at most
+   BENCH_VIEW_W x BENCH_VIEW_H whatever the arena size, like a terminal.
+   The ANSI backend writes its frames to /dev/null; the null backend shows
+   what the renderer costs by itself. */
+static void benchRender( int size, bool full_redraw, int backend, char * name ) {
+	Game game;
+	Rng rng;
+	rngSeed( &rng, 1 );
+	if( !gameInit( &game, size, size, BOARDTYPE_EMPTY, &rng ) ) {
+		return;
+	}
+	int view_w = size < BENCH_VIEW_W ? size : BENCH_VIEW_W;
+	int view_h = size < BENCH_VIEW_H ? size : BENCH_VIEW_H;
+
+	int fd = -1;
+	if( backend == RENDER_BACKEND_ANSI ) {
+		fd = open( "/dev/null", O_WRONLY );
+		if( fd < 0 ) {
+			gameFree( &game );
+			return;
+		}
+	}
+	else if( backend == RENDER_BACKEND_CURSES ) {
+		resizeterm( view_h, view_w );
+		clear();
+	}
+
+	Renderer r;
+	Coord offset = { 0, 0 };
+	if( !renderInitBackend( &r, view_w, view_h, offset, backend, fd ) ) {
+		gameFree( &game );
+		if( fd >= 0 ) {
+			close( fd );
+		}
+		return;
+	}
+
+	long iters = 0;
+	double elapsed = 0;
+	while( elapsed < BENCH_MIN_NS ) {
+		double start = nowNs();
+		int i;
+		for( i = 0; i < 100; i++ ) {
+			if( gameStep( &game, steer( &game ) ) == STEP_GAME_OVER ) {
+				break;
+			}
+			if( full_redraw ) {
+				renderInvalidate( &r );
+			}
+			renderArena( &r, &game );
+			renderFlush( &r );
+		}
+		elapsed += nowNs() - start;
+		iters += i;
+
+		if( game.over ) {
+			gameFree( &game );
+			rngSeed( &rng, iters );
+			if( !gameInit( &game, size, size, BOARDTYPE_EMPTY, &rng ) ) {
+				break;
+			}
+			renderInvalidate( &r );
+		}
+	}
+	report( name, size, size, iters, elapsed, 1 );
+	renderFree( &r );
+	gameFree( &game );
+	if( fd >= 0 ) {
+		close( fd );
+	}
+}
+
+static void benchBoardSave( Board * brd, char * name, int format ) {
+	long iters = 0;
+	double start = nowNs();
+	double elapsed = 0;
+	while( elapsed < BENCH_MIN_NS ) {
+		if( !boardSaveToFile( brd, BENCH_TMP_FILE, format ) ) {
+			fprintf( stderr, "%s: boardSaveToFile() failed\n", name );
+			return;
+		}
+		iters++;
+		elapsed = nowNs() - start;
+	}
+	report( name, brd->w, brd->h, iters, elapsed, (double)brd->w * brd->h );
+}
+
+static void benchBoardLoad( char * filename, char * name ) {
+	long iters = 0;
+	int w = 0, h = 0;
+	double start = nowNs();
+	double elapsed = 0;
+	while( elapsed < BENCH_MIN_NS ) {
+		Board * brd = boardLoadFromFile( filename );
+		if( !brd ) {
+			fprintf( stderr, "%s: boardLoadFromFile() failed on %s\n", name, filename );
+			return;
+		}
+		w = brd->w;
+		h = brd->h;
+		boardFree( brd );
+		iters++;
+		elapsed = nowNs() - start;
+	}
+	report( name, w, h, iters, elapsed, (double)w * h );
+}
+
+static void benchBoardIO( int size ) {
+	Board * brd = makeNoiseBoard( size, size, 11 );
+	if( !brd ) {
+		return;
+	}
+	if( wanted( "board_save" ) ) {
+		benchBoardSave( brd, "board_save", BOARD_FORMAT_TEXT );
+	}
+	if( wanted( "board_load" ) && boardSaveToFile( brd, BENCH_TMP_FILE, BOARD_FORMAT_TEXT ) ) {
+		benchBoardLoad( BENCH_TMP_FILE, "board_load" );
+	}
+	if( wanted( "board_save_bin" ) ) {
+		benchBoardSave( brd, "board_save_bin", BOARD_FORMAT_BINARY );
+	}
+	if( wanted( "board_load_bin" ) && boardSaveToFile( brd, BENCH_TMP_FILE, BOARD_FORMAT_BINARY ) ) {
+		benchBoardLoad( BENCH_TMP_FILE, "board_load_bin" );
+	}
+	boardFree( brd );
+	remove( BENCH_TMP_FILE );
+}
+
+static void benchFloodFill( int size ) {
+	Board * brd = boardInit( size, size, true );
+	if( !brd ) {
+		return;
+	}
+	FillWork work;
+	fillWorkInit( &work );
+
+	// Alternate between two fills so that every pass repaints the whole board.
+	Cell a = boardGetCell( brd, 0, 0 );
+	Cell b = cellMake( '.', cellFg( a ), cellBg( a ), cellBright( a ), cellBlink( a ) );
+
+	long iters = 0;
+	double start = nowNs();
+	double elapsed = 0;
+	while( elapsed < BENCH_MIN_NS ) {
+		floodFillWith( brd, &work, a, b, size / 2, size / 2 );
+		Cell t = a;
+		a = b;
+		b = t;
+		iters++;
+		elapsed = nowNs() - start;
+	}
+	report( "flood_fill", size, size, iters, elapsed, (double)size * size );
+	fillWorkFree( &work );
+	boardFree( brd );
+}
+
+// Region size queries on a board split into two-cell-wide vertical stripes.
+static void benchFloodMeasure( int size ) {
+	Board * brd = boardInit( size, size, true );
+	if( !brd ) {
+		return;
+	}
+	int x, y;
+	for( y = 0; y < size; y++ ) {
+		for( x = 0; x < size; x++ ) {
+			boardPutCell( brd, cellMake( ( x / 2 ) % 2 ? '#' : ' ', COLOR_WHITE, COLOR_BLACK, 1, 0 ), x, y );
+		}
+	}
+	FillWork work;
+	fillWorkInit( &work );
+
+	long iters = 0;
+	long cells = 0;
+	double start = nowNs();
+	double elapsed = 0;
+	while( elapsed < BENCH_MIN_NS ) {
+		cells += floodMeasure( brd, &work, (int)( iters * 2 ) % size, size / 2, NULL, 0 );
+		iters++;
+		elapsed = nowNs() - start;
+	}
+	report( "flood_measure", size, size, iters, elapsed, (double)cells / iters );
+	fillWorkFree( &work );
+	boardFree( brd );
+}
+
+/* Region size queries on a huge, nearly blank board: the inside of a walled
+   box in the middle, 'box' cells across. Only the box's tiles are ever
+   allocated, by the board or by the query, so this should cost about what
+   measuring the same box on a small board does. */
+static void benchFloodMeasureSparse( int size, int box ) {
+	Board * brd = boardInit( size, size, true );
+	if( !brd ) {
+		return;
+	}
+	int x0 = size / 2 - box / 2;
+	int y0 = size / 2 - box / 2;
+	Cell wall = cellMake( '#', COLOR_WHITE, COLOR_BLACK, 1, 0 );
+	boardFill( brd, wall, x0, y0, box, 1 );
+	boardFill( brd, wall, x0, y0 + box - 1, box, 1 );
+	boardFill( brd, wall, x0, y0, 1, box );
+	boardFill( brd, wall, x0 + box - 1, y0, 1, box );
+
+	FillWork work;
+	fillWorkInit( &work );
+
+	long iters = 0;
+	long cells = 0;
+	double start = nowNs();
+	double elapsed = 0;
+	while( elapsed < BENCH_MIN_NS ) {
+		int n = floodMeasure( brd, &work, size / 2, size / 2, NULL, 0 );
+		if( n < 0 ) {
+			fprintf( stderr, "flood_measure: floodMeasure() failed on %dx%d.\n", size, size );
+			break;
+		}
+		cells += n;
+		iters++;
+		elapsed = nowNs() - start;
+	}
+	if( iters > 0 ) {
+		report( "flood_measure", size, size, iters, elapsed, (double)cells / iters );
+	}
+	fillWorkFree( &work );
+	boardFree( brd );
+}
+
+/* Whole-board copies between two boards: opaque through boardCopySection(),
+   masked through boardBlit() with black as the transparent color, and an
+   overlapping copy within one board shifted by one cell diagonally. */
+static void benchCopySection( int size, char * name ) {
+	Board * src = makeNoiseBoard( size, size, 13 );
+	Board * dest = boardInit( size, size, true );
+	if( !src || !dest ) {
+		boardFree( src );
+		boardFree( dest );
+		return;
+	}
+
+	long iters = 0;
+	double start = nowNs();
+	double elapsed = 0;
+	while( elapsed < BENCH_MIN_NS ) {
+		if( strcmp( name, "board_blit_masked" ) == 0 ) {
+			boardBlit( src, dest, 0, 0, size, size, 0, 0, COLOR_BLACK );
+		}
+		else if( strcmp( name, "board_blit_overlap" ) == 0 ) {
+			boardBlit( src, src, 0, 0, size, size, ( iters % 2 ) ? -1 : 1, ( iters % 2 ) ? -1 : 1, BLIT_OPAQUE );
+		}
+		else {
+			boardCopySection( src, dest, 0, 0, size, size, 0, 0 );
+		}
+		iters++;
+		elapsed = nowNs() - start;
+	}
+	report( name, size, size, iters, elapsed, (double)size * size );
+	boardFree( src );
+	boardFree( dest );
+}
+
+static void benchWipe( int size ) {
+	Board * brd = boardInit( size, size, true );
+	if( !brd ) {
+		return;
+	}
+	long iters = 0;
+	double start = nowNs();
+	double elapsed = 0;
+	while( elapsed < BENCH_MIN_NS ) {
+		boardWipe( brd, iters % 2 ? '.' : ' ', COLOR_WHITE, COLOR_BLACK, 1, 0 );
+		iters++;
+		elapsed = nowNs() - start;
+	}
+	report( "board_wipe", size, size, iters, elapsed, (double)size * size );
+	boardFree( brd );
+}
+
+// Curses on a terminal that writes to /dev/null, for the draw benchmarks.
+static SCREEN * nullScreenInit( void ) {
+	if( !getenv( "TERM" ) ) {
+		setenv( "TERM", "xterm", 0 );
+	}
+	FILE * out = fopen( "/dev/null", "w" );
+	FILE * in = fopen( "/dev/null", "r" );
+	if( !out || !in ) {
+		return NULL;
+	}
+	SCREEN * screen = newterm( NULL, out, in );
+	if( !screen ) {
+		return NULL;
+	}
+	start_color();
+	curses_init_color_pairs();
+	return screen;
+}
+
+int main( int argc, char *argv[] ) {
+	int i;
+	for( i = 1; i < argc; i++ ) {
+		if( strcmp( argv[i], "--max" ) == 0 && i + 1 < argc ) {
+			max_size = atoi( argv[++i] );
+		}
+		else if( strcmp( argv[i], "--only" ) == 0 && i + 1 < argc ) {
+			only = argv[++i];
+		}
+		else if( strcmp( argv[i], "--brd" ) == 0 && i + 1 < argc ) {
+			brd_file = argv[++i];
+		}
+		else {
+			fprintf( stderr, "Usage: %s [--max SIZE] [--only NAME] [--brd FILE]\n", argv[0] );
+			return 1;
+		}
+	}
+
+	SCREEN * screen = NULL;
+	if( wanted( "board_draw" ) || wanted( "render_tick" ) || wanted( "render_full" ) ) {
+		screen = nullScreenInit();
+		if( !screen ) {
+			fprintf( stderr, "Could not start Curses on /dev/null; skipping draw benchmarks.\n" );
+		}
+	}
+
+	// The shipped title art first.
+	if( wanted( "board_load_brd" ) ) {
+		benchBoardLoad( brd_file, "board_load_brd" );
+	}
+
+	for( i = 0; i < N_BENCH_SIZES && bench_sizes[i] <= max_size; i++ ) {
+		int size = bench_sizes[i];
+
+		if( wanted( "tick" ) ) {
+			benchTick( size );
+		}
+		if( wanted( "tick_snapshot" ) ) {
+			benchTickSnapshot( size );
+		}
+		if( wanted( "tick_autopilot" ) ) {
+			benchTickAutopilot( size );
+		}
+		if( wanted( "put_cell_random" ) ) {
+			benchPutCellRandom( size );
+		}
+		if( screen && wanted( "board_draw" ) ) {
+			benchBoardDraw( size );
+		}
+		if( screen && wanted( "render_tick" ) ) {
+			benchRender( size, false, RENDER_BACKEND_CURSES, "render_tick" );
+		}
+		if( screen && wanted( "render_full" ) ) {
+			benchRender( size, true, RENDER_BACKEND_CURSES, "render_full" );
+		}
+		if( wanted( "render_tick_ansi" ) ) {
+			benchRender( size, false, RENDER_BACKEND_ANSI, "render_tick_ansi" );
+		}
+		if( wanted( "render_full_ansi" ) ) {
+			benchRender( size, true, RENDER_BACKEND_ANSI, "render_full_ansi" );
+		}
+		if( wanted( "render_tick_null" ) ) {
+			benchRender( size, false, RENDER_BACKEND_NULL, "render_tick_null" );
+		}
+		benchBoardIO( size );
+		if( wanted( "flood_fill" ) ) {
+			benchFloodFill( size );
+		}
+		if( wanted( "flood_measure" ) ) {
+			benchFloodMeasure( size );
+		}
+		if( wanted( "board_copy_section" ) ) {
+			benchCopySection( size, "board_copy_section" );
+		}
+		if( wanted( "board_blit_masked" ) ) {
+			benchCopySection( size, "board_blit_masked" );
+		}
+		if( wanted( "board_blit_overlap" ) ) {
+			benchCopySection( size, "board_blit_overlap" );
+		}
+		if( wanted( "board_wipe" ) ) {
+			benchWipe( size );
+		}
+	}
+
+	// Far bigger than any dense benchmark: only what is written to costs anything.
+	if( wanted( "tick_snapshot" ) ) {
+		benchTickSnapshot( BENCH_SPARSE_SIZE );
+	}
+	if( wanted( "flood_measure" ) ) {
+		benchFloodMeasureSparse( BENCH_SPARSE_SIZE, 1024 );
+	}
+
+	if( screen ) {
+		endwin();
+		delscreen( screen );
+	}
+	return 0;
+}
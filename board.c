@@ -1,5 +1,8 @@
 #include "board.h"
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 bool outOfBounds( int x, int y, int w, int h ) {
 	return ( x < 0 || x > w - 1 || y < 0 || y > h - 1 );
 }
@@ -7,40 +10,61 @@ bool outOfBounds( int x, int y, int w, int h ) {
 
 Cell boardGetCell( Board * board, int x, int y ) {
 	if( outOfBounds( x, y, board->w, board->h ) ) {
-		Cell oob;
-		oob.pattern = CELL_OUT_OF_BOUNDS;
-		return oob;
+		return CELL_OUT_OF_BOUNDS;
 	}
 	else {
-		return board->cells[ x*board->h + y ];
+		return gridAt( &board->grid, x, y );
 	}
 }
 
 void boardPutCell( Board * board, Cell new_cell, int x, int y ) {
 	if( !outOfBounds( x, y, board->w, board->h ) ) {
-		board->cells[ x*board->h + y ] = new_cell;
+		if( !gridPut( &board->grid, x, y, new_cell ) ) {
+			errLog( "boardPutCell(): Could not allocate a tile for cell %d,%d", x, y );
+		}
 	}
 }
 
-void boardWipe( Board * board, int wipe_pattern, int fg, int bg, int bright, int blink ) {
-	int x, y;
-	for( x = 0; x < board->w; x++ ) {
-		for( y = 0; y < board->h; y++ ) {
-			Cell empty;
-			empty.pattern = wipe_pattern;
-			empty.fg = fg;
-			empty.bg = bg;
-			empty.bright = bright;
-			empty.blink = blink;
-
-			boardPutCell( board, empty, x, y );
+/* Set n cells along row y of a grid, starting at x, one tile-wide span at a
+   time. Spans that would stay blank are left alone. No bounds checking.
+   Returns false if a tile could not be allocated. */
+static bool gridSetRun( TileGrid * grid, uint32_t value, int x, int y, int n ) {
+	while( n > 0 ) {
+		int len, i;
+		if( value == grid->fill && gridTileBlank( grid, gridTileIndex( grid, x, y ) ) ) {
+			gridSpan( grid, x, y, &len );
+		}
+		else {
+			uint32_t * span = gridSpanW( grid, x, y, &len );
+			if( !span ) {
+				errLog( "gridSetRun(): Could not allocate a tile for cell %d,%d", x, y );
+				return false;
+			}
+			for( i = 0; i < len && i < n; i++ ) {
+				span[i] = value;
+			}
 		}
+		x += len;
+		n -= len;
+	}
+	return true;
+}
+
+static bool boardSetRun( Board * board, Cell cell, int x, int y, int n ) {
+	return gridSetRun( &board->grid, cell, x, y, n );
+}
+
+// Every tile goes back to the shared blank tile, so this costs the number of tiles, not cells.
+void boardWipe( Board * board, int wipe_pattern, int fg, int bg, int bright, int blink ) {
+	if( !gridClear( &board->grid, cellMake( wipe_pattern, fg, bg, bright, blink ) ) ) {
+		errLog( "boardWipe(): gridClear() failed." );
 	}
 }
 
 #define TEST_FILE "test_file.sav"
 
-Board * boardInit( int w, int h, bool color ) {
+/* Allocate a board with every cell set to 'fill'. */
+static Board * boardAlloc( int w, int h, bool color, Cell fill ) {
 	if( w < 1 || h < 1 ) {
 		errLog( "boardInit(): invalid dimensions." );
 		return NULL;
@@ -64,36 +88,69 @@ Board * boardInit( int w, int h, bool color ) {
 	}
 	strncpy( new_board->filename, TEST_FILE, sizeof( TEST_FILE ) );
 
-	new_board->cells = malloc( (new_board->w * new_board->h) * sizeof(Cell) );
-	if( !new_board->cells ) {
-		errLog( "boardInit(): malloc() failed on new_board->cells" );
-		exit(1);
+	if( !gridInit( &new_board->grid, w, h, fill ) ) {
+		errLog( "boardInit(): gridInit() failed on a %dx%d board", w, h );
+		free( new_board->filename );
+		free( new_board );
 		return NULL;
 	}
-	
-	boardWipe( new_board, ' ', COLOR_WHITE, COLOR_BLACK, 1, 0 );
 
 	return new_board;
 }
 
+Board * boardInit( int w, int h, bool color ) {
+	return boardAlloc( w, h, color, cellMake( ' ', COLOR_WHITE, COLOR_BLACK, 1, 0 ) );
+}
+
 void boardFree( Board * board ) {
 	if( board ) {
-		free( board->cells );
+		gridFree( &board->grid );
 		free( board->filename );
 		free( board );
 	}
 }
 
+/* Draws row by row, handing each row to Curses as a single chtype string.
+   The color pair and attributes are only looked up again when they change
+   from one cell to the next, so a run of same-colored cells costs one
+   colorAttr() call in total. */
 void boardDraw( Board * board, Coord offset, bool draw_border ) {
+	chtype * row = malloc( board->w * sizeof(chtype) );
+	if( !row ) {
+		errLog( "boardDraw(): malloc() failed on row buffer" );
+		return;
+	}
+
+	// Curses rejects a string that starts left of the screen, so clip it here.
+	int skip = offset.x < 0 ? -offset.x : 0;
+
 	int x, y;
 	Cell current;
-	for( x = 0; x < board->w; x++ ) {
-		for( y = 0; y < board->h; y++ ) {
-			current = boardGetCell( board, x, y );
-			colorSet( current.fg, current.bg, current.bright, current.blink );
-			mvaddch( y + offset.y, x + offset.x, current.pattern );
+	Cell last = gridAt( &board->grid, 0, 0 );
+	attr_t attr = colorAttr( cellFg( last ), cellBg( last ), cellBright( last ), cellBlink( last ) );
+
+	for( y = 0; y < board->h; y++ ) {
+		// The row comes out of the grid one tile-wide span at a time.
+		x = 0;
+		while( x < board->w ) {
+			int n, i;
+			const Cell * span = gridSpan( &board->grid, x, y, &n );
+			for( i = 0; i < n; i++ ) {
+				current = span[i];
+				if( ( current & CELL_ATTR_MASK ) != ( last & CELL_ATTR_MASK ) ) {
+					attr = colorAttr( cellFg( current ), cellBg( current ), cellBright( current ), cellBlink( current ) );
+					last = current;
+				}
+				row[ x + i ] = cellPattern( current ) | attr;
+			}
+			x += n;
+		}
+		if( skip < board->w ) {
+			mvaddchnstr( y + offset.y, offset.x + skip, row + skip, board->w - skip );
 		}
 	}
+	free( row );
+
 	if( draw_border ) {
 		colorSet( COLOR_BLACK, COLOR_BLACK, 1, 0 );
 		for( x = 0; x < board->w; x++ ) {
@@ -116,40 +173,324 @@ void boardDraw( Board * board, Coord offset, bool draw_border ) {
 	}
 }
 
+// Whether these values fit in a packed Cell.
+bool cellValid( int pattern, int fg, int bg ) {
+	return ( pattern >= 0 && pattern <= CELL_PATTERN_MASK
+		&& fg >= 0 && fg < N_COLORS && bg >= 0 && bg < N_COLORS );
+}
+
+Cell cellMake( int pattern, int fg, int bg, int bright, int blink ) {
+	return ( (Cell)pattern & CELL_PATTERN_MASK )
+		| ( (Cell)( fg & 7 ) << CELL_FG_SHIFT )
+		| ( (Cell)( bg & 7 ) << CELL_BG_SHIFT )
+		| ( bright ? CELL_BRIGHT_BIT : 0 )
+		| ( blink ? CELL_BLINK_BIT : 0 );
+}
+
 bool sameCells( Cell a, Cell b ) {
-	bool retval = false;
+	return a == b;
+}
+
+/* Scanline flood fill. Instead of recursing once per cell, each step takes a
+   seed off an explicit stack, extends it left and right into the longest
+   matching span on its row, handles the whole span at once, and then pushes
+   one new seed for each run of matching cells directly above and below it.
+
+   The same walk serves both floodFillWith(), which paints the region, and
+   floodMeasure(), which leaves the board alone and instead marks visited
+   cells in the FillWork (and optionally writes a label for each cell).
+
+   Visited cells are kept like the board itself, a tile at a time: one
+   bitmap per tile the region reaches, found through a small hash on the
+   tile number, so a query costs memory for the region it measures and not
+   for the whole board. Bitmaps come from a pool that, like the hash, is
+   kept between queries and only ever grows. */
+
+void fillWorkInit( FillWork * work ) {
+	work->stack = NULL;
+	work->n = 0;
+	work->cap = 0;
+	work->seen_keys = NULL;
+	work->seen_maps = NULL;
+	work->seen_slots = 0;
+	work->seen_used = 0;
+	work->seen_pool = NULL;
+	work->pool_cap = 0;
+	work->last_key = -1;
+	work->last_map = NULL;
+}
+
+void fillWorkFree( FillWork * work ) {
+	free( work->stack );
+	free( work->seen_keys );
+	free( work->seen_maps );
+	free( work->seen_pool );
+	fillWorkInit( work );
+}
+
+static bool fillPush( FillWork * work, int x, int y ) {
+	if( work->n == work->cap ) {
+		int new_cap = work->cap ? work->cap * 2 : 256;
+		Coord * new_stack = realloc( work->stack, new_cap * sizeof(Coord) );
+		if( !new_stack ) {
+			errLog( "fillPush(): realloc() failed growing the fill stack to %d entries", new_cap );
+			return false;
+		}
+		work->stack = new_stack;
+		work->cap = new_cap;
+	}
+	work->stack[ work->n ].x = x;
+	work->stack[ work->n ].y = y;
+	work->n++;
+	return true;
+}
 
-	if( a.pattern == b.pattern
-		&& a.fg == b.fg
-		&& a.bg == b.bg
-		&& a.bright == b.bright
-		&& a.blink == b.blink ) {
-			retval = true;
+// Forget every visited cell. Costs the size of the hash, which follows the largest region so far.
+static void fillSeenReset( FillWork * work ) {
+	if( work->seen_used > 0 ) {
+		memset( work->seen_keys, 0xFF, work->seen_slots * sizeof(int) );
+		work->seen_used = 0;
 	}
+	work->last_key = -1;
+	work->last_map = NULL;
+}
 
-	return retval;
+static int fillSeenSlot( FillWork * work, int t ) {
+	int slot = (int)( ( (uint32_t)t * 2654435761u ) & (uint32_t)( work->seen_slots - 1 ) );
+	while( work->seen_keys[slot] != -1 && work->seen_keys[slot] != t ) {
+		slot = ( slot + 1 ) & ( work->seen_slots - 1 );
+	}
+	return slot;
 }
 
-void floodFill( Board * board, Cell first, Cell second, int x, int y ) {
-	if( !outOfBounds( x, y, board->w, board->h ) ) {
-	
-		Cell check = boardGetCell( board, x, y );
+// Double the hash, keeping what is in it.
+static bool fillSeenGrow( FillWork * work ) {
+	int old_slots = work->seen_slots;
+	int * old_keys = work->seen_keys;
+	int * old_maps = work->seen_maps;
+	int slots = old_slots ? old_slots * 2 : 64;
+
+	work->seen_keys = malloc( slots * sizeof(int) );
+	work->seen_maps = malloc( slots * sizeof(int) );
+	if( !work->seen_keys || !work->seen_maps ) {
+		errLog( "fillSeenGrow(): malloc() failed on a hash of %d tiles", slots );
+		free( work->seen_keys );
+		free( work->seen_maps );
+		work->seen_keys = old_keys;
+		work->seen_maps = old_maps;
+		return false;
+	}
+	memset( work->seen_keys, 0xFF, slots * sizeof(int) );
+	work->seen_slots = slots;
+
+	int i;
+	for( i = 0; i < old_slots; i++ ) {
+		if( old_keys[i] != -1 ) {
+			int slot = fillSeenSlot( work, old_keys[i] );
+			work->seen_keys[slot] = old_keys[i];
+			work->seen_maps[slot] = old_maps[i];
+		}
+	}
+	free( old_keys );
+	free( old_maps );
+	return true;
+}
+
+/* The visited-cell bitmap of tile t. If it has none, returns NULL, or with
+   'add' set, gives it a cleared one. Returns NULL if that fails. */
+static uint64_t * fillSeenMap( FillWork * work, int t, bool add ) {
+	if( work->seen_slots > 0 ) {
+		int slot = fillSeenSlot( work, t );
+		if( work->seen_keys[slot] == t ) {
+			return work->seen_pool + (size_t)work->seen_maps[slot] * FILL_MAP_WORDS;
+		}
+	}
+	if( !add ) {
+		return NULL;
+	}
+
+	if( ( work->seen_used + 1 ) * 2 > work->seen_slots && !fillSeenGrow( work ) ) {
+		return NULL;
+	}
+	if( work->seen_used == work->pool_cap ) {
+		int new_cap = work->pool_cap ? work->pool_cap * 2 : 16;
+		uint64_t * new_pool = realloc( work->seen_pool, (size_t)new_cap * FILL_MAP_WORDS * sizeof(uint64_t) );
+		if( !new_pool ) {
+			errLog( "fillSeenMap(): realloc() failed growing the pool to %d bitmaps", new_cap );
+			return NULL;
+		}
+		work->seen_pool = new_pool;
+		work->pool_cap = new_cap;
+		work->last_key = -1;	// The pool moved.
+	}
 
-		if( sameCells( check, first ) && !sameCells( first, second ) ) {
-			boardPutCell( board, second, x, y );
+	int slot = fillSeenSlot( work, t );
+	work->seen_keys[slot] = t;
+	work->seen_maps[slot] = work->seen_used;
+	uint64_t * map = work->seen_pool + (size_t)work->seen_used * FILL_MAP_WORDS;
+	memset( map, 0, FILL_MAP_WORDS * sizeof(uint64_t) );
+	work->seen_used++;
+	return map;
+}
+
+// Whether x,y has been visited this query. Consecutive lookups are nearly always in the same tile.
+static inline bool fillSeen( FillWork * work, TileGrid * grid, int x, int y ) {
+	int t = gridTileIndex( grid, x, y );
+	if( t != work->last_key ) {
+		work->last_map = fillSeenMap( work, t, false );
+		work->last_key = t;
+	}
+	if( !work->last_map ) {
+		return false;
+	}
+	int c = gridCellIndex( x, y );
+	return ( work->last_map[ c >> 6 ] >> ( c & 63 ) ) & 1;
+}
+
+// Mark n cells along row y, from x, as visited.
+static bool fillMarkRun( FillWork * work, TileGrid * grid, int x, int y, int n ) {
+	while( n > 0 ) {
+		int t = gridTileIndex( grid, x, y );
+		if( t != work->last_key || !work->last_map ) {
+			work->last_map = fillSeenMap( work, t, true );
+			work->last_key = t;
+			if( !work->last_map ) {
+				work->last_key = -1;
+				return false;
+			}
+		}
+		uint64_t * map = work->last_map;
+
+		int len = TILE_SIZE - ( x & TILE_MASK );
+		if( len > n ) {
+			len = n;
+		}
+		int c = gridCellIndex( x, y );
+		int i;
+		for( i = c; i < c + len; i++ ) {
+			map[ i >> 6 ] |= 1ULL << ( i & 63 );
+		}
+		x += len;
+		n -= len;
+	}
+	return true;
+}
+
+// With measure set, a cell only matches once per query.
+#define FILL_MATCH( x, y ) ( gridAt( grid, x, y ) == target \
+	&& ( !measure || !fillSeen( work, grid, x, y ) ) )
+
+static int fillRun( Board * board, FillWork * work, Cell target, Cell replace, bool measure,
+	TileGrid * labels, uint32_t label, int x, int y ) {
+
+	TileGrid * grid = &board->grid;
+	int w = board->w;
+	int count = 0;
+
+	work->n = 0;
+	if( !fillPush( work, x, y ) ) {
+		return -1;
+	}
+
+	while( work->n > 0 ) {
+		work->n--;
+		x = work->stack[ work->n ].x;
+		y = work->stack[ work->n ].y;
+
+		if( !FILL_MATCH( x, y ) ) {
+			continue;
+		}
+
+		// Grow the seed into the whole span on this row.
+		int left = x;
+		int right = x;
+		while( left > 0 && FILL_MATCH( left - 1, y ) ) {
+			left--;
+		}
+		while( right < w - 1 && FILL_MATCH( right + 1, y ) ) {
+			right++;
+		}
+
+		int len = right - left + 1;
+		if( measure ) {
+			if( !fillMarkRun( work, grid, left, y, len ) ) {
+				return -1;
+			}
+			if( labels && !gridSetRun( labels, label, left, y, len ) ) {
+				return -1;
+			}
+		}
+		else if( !boardSetRun( board, replace, left, y, len ) ) {
+			return -1;
+		}
+		if( count > INT_MAX - len ) {
+			errLog( "fillRun(): the region around %d,%d has more cells than an int can count", x, y );
+			return -1;
+		}
+		count += len;
 
-			floodFill( board, first, second, x - 1, y );
-			floodFill( board, first, second, x + 1, y );
-			floodFill( board, first, second, x, y - 1 );
-			floodFill( board, first, second, x, y + 1 );
+		// One seed per run of matching cells on the neighboring rows.
+		int ny;
+		for( ny = y - 1; ny <= y + 1; ny += 2 ) {
+			if( ny < 0 || ny >= board->h ) {
+				continue;
+			}
+			bool in_run = false;
+			int nx;
+			for( nx = left; nx <= right; nx++ ) {
+				if( FILL_MATCH( nx, ny ) ) {
+					if( !in_run && !fillPush( work, nx, ny ) ) {
+						return -1;
+					}
+					in_run = true;
+				}
+				else {
+					in_run = false;
+				}
+			}
 		}
 	}
+
+	return count;
+}
+
+#undef FILL_MATCH
+
+// Replace the region of cells equal to 'first' around x,y with 'second'. Returns the cell count, or -1.
+int floodFillWith( Board * board, FillWork * work, Cell first, Cell second, int x, int y ) {
+	if( outOfBounds( x, y, board->w, board->h ) || sameCells( first, second ) ) {
+		return 0;
+	}
+	return fillRun( board, work, first, second, false, NULL, 0, x, y );
+}
+
+void floodFill( Board * board, Cell first, Cell second, int x, int y ) {
+	FillWork work;
+	fillWorkInit( &work );
+	floodFillWith( board, &work, first, second, x, y );
+	fillWorkFree( &work );
+}
+
+/* Count the cells connected to x,y that are the same as the cell at x,y,
+   without changing the board. If 'labels' is given (a grid the size of the
+   board), every cell in the region is set to 'label' there; like the board,
+   it only takes memory where the labels are not its fill value. Returns the
+   region size, or -1 if the work space could not be allocated or the
+   region is too big to count. */
+int floodMeasure( Board * board, FillWork * work, int x, int y, TileGrid * labels, uint32_t label ) {
+	if( outOfBounds( x, y, board->w, board->h ) ) {
+		return 0;
+	}
+	fillSeenReset( work );
+
+	Cell target = gridAt( &board->grid, x, y );
+	return fillRun( board, work, target, target, true, labels, label, x, y );
 }
 
-bool boardSaveToFile( Board * brd, char * filename ) {
+static bool boardSaveText( Board * brd, char * filename ) {
 	FILE * f = fopen ( filename, "w" );
 	if( !f ) {
-		errLog( "boardSaveToFile(): Could not open %s for writing", filename );
+		errLog( "boardSaveText(): Could not open %s for writing", filename );
 		return false;
 	}
 	fprintf( f, "%d\n%d\n%d\n", brd->w, brd->h, brd->color_enabled );
@@ -160,115 +501,481 @@ bool boardSaveToFile( Board * brd, char * filename ) {
 
 			Cell work = boardGetCell( brd, x, y );
 
-			fprintf( f, "%d\n", work.pattern );
-			fprintf( f, "%d\n", work.fg );
-			fprintf( f, "%d\n", work.bg );
-			fprintf( f, "%d\n", work.bright );
-			fprintf( f, "%d\n", work.blink );
+			fprintf( f, "%d\n", cellPattern( work ) );
+			fprintf( f, "%d\n", cellFg( work ) );
+			fprintf( f, "%d\n", cellBg( work ) );
+			fprintf( f, "%d\n", cellBright( work ) );
+			fprintf( f, "%d\n", cellBlink( work ) );
 		}
 	}
 	fclose( f );
 	return true;
 }
 
-Board * boardLoadFromFile( char * filename ) {
-//bool boardLoadFromFile( Board * brd, char * filename ) {
-	FILE * f = fopen( filename, "r" );
+// Cells are already in their on-disk form, so they go out a span at a time.
+static bool boardSaveBinary( Board * brd, char * filename ) {
+	FILE * f = fopen( filename, "wb" );
 	if( !f ) {
-		errLog( "boardLoadFromFile(): Could not load %s", filename );
+		errLog( "boardSaveBinary(): Could not open %s for writing", filename );
+		return false;
+	}
+
+	BoardBinHeader hdr;
+	memset( &hdr, 0, sizeof(hdr) );
+	memcpy( hdr.magic, BOARD_BIN_MAGIC, sizeof(hdr.magic) );
+	hdr.byte_order = BOARD_BIN_BYTE_ORDER;
+	hdr.version = BOARD_BIN_VERSION;
+	hdr.cell_size = sizeof(Cell);
+	hdr.w = brd->w;
+	hdr.h = brd->h;
+	hdr.color_enabled = brd->color_enabled;
+
+	bool ok = fwrite( &hdr, sizeof(hdr), 1, f ) == 1;
+	int x, y;
+	for( y = 0; y < brd->h && ok; y++ ) {
+		for( x = 0; x < brd->w && ok; ) {
+			int n;
+			const Cell * span = gridSpan( &brd->grid, x, y, &n );
+			ok = fwrite( span, sizeof(Cell), n, f ) == (size_t)n;
+			x += n;
+		}
+	}
+	if( !ok ) {
+		errLog( "boardSaveBinary(): write failed on %s", filename );
+	}
+
+	if( fclose( f ) != 0 ) {
+		ok = false;
+	}
+	return ok;
+}
+
+bool boardSaveToFile( Board * brd, char * filename, int format ) {
+	if( format == BOARD_FORMAT_BINARY ) {
+		return boardSaveBinary( brd, filename );
+	}
+	return boardSaveText( brd, filename );
+}
+
+/* Text board parsing. The whole file is mapped and scanned in place: one
+   decimal integer per line, as written by boardSaveText(). Anything else is
+   reported with the line it was found on, rather than silently turning into
+   blank cells. */
+
+typedef struct TextScanner_t {
+	const char * p;
+	const char * end;
+	long line;
+} TextScanner;
+
+// Read the integer on the current line and move on to the next one.
+static bool scanInt( TextScanner * sc, int * out ) {
+	const char * p = sc->p;
+	const char * end = sc->end;
+
+	while( p < end && ( *p == ' ' || *p == '\t' ) ) {
+		p++;
+	}
+	bool negative = false;
+	if( p < end && ( *p == '-' || *p == '+' ) ) {
+		negative = ( *p == '-' );
+		p++;
+	}
+	if( p >= end || *p < '0' || *p > '9' ) {
 		return false;
 	}
-	#define BUF_LEN 32
-	int w = 0, h = 0, color_enabled = false;
 
-	Cell work;
-	work.pattern = ' ';
-	work.fg = COLOR_WHITE;
-	work.bg = COLOR_BLACK;
-	work.bright = true;
-	work.blink = false;
+	long long value = 0;
+	while( p < end && *p >= '0' && *p <= '9' ) {
+		value = value * 10 + ( *p - '0' );
+		if( value > (long long)INT_MAX + 1 ) {
+			return false;
+		}
+		p++;
+	}
+	if( negative ) {
+		value = -value;
+	}
+	if( value > INT_MAX || value < INT_MIN ) {
+		return false;
+	}
 
-	char buf[BUF_LEN];
-	if( fgets( buf, BUF_LEN, f ) != NULL ) {
-		w = atoi( buf );
+	// The line must end here. The last line of the file may lack its newline.
+	if( p < end && *p == '\r' ) {
+		p++;
 	}
-	if( fgets( buf, BUF_LEN, f ) != NULL ) {
-		h = atoi( buf );
+	if( p < end ) {
+		if( *p != '\n' ) {
+			return false;
+		}
+		p++;
 	}
-	if( fgets( buf, BUF_LEN, f ) != NULL ) {
-		color_enabled = atoi( buf );
+
+	*out = (int)value;
+	sc->p = p;
+	sc->line++;
+	return true;
+}
+
+static void scanError( TextScanner * sc, char * filename, char * expected ) {
+	if( sc->p >= sc->end ) {
+		errLog( "boardLoadText(): %s ends at line %ld; expected %s", filename, sc->line, expected );
 	}
+	else {
+		errLog( "boardLoadText(): %s line %ld: expected %s", filename, sc->line, expected );
+	}
+}
 
-	if( w < 1 || h < 1 ) {
-		errLog( "boardLoadFromFile(): invalid dimensions (w%d h%d) on %s", w, h, filename ); 
+static Board * boardLoadText( const char * data, size_t size, char * filename ) {
+	TextScanner sc;
+	sc.p = data;
+	sc.end = data + size;
+	sc.line = 1;
+
+	int w, h, color_enabled;
+	if( !scanInt( &sc, &w ) ) {
+		scanError( &sc, filename, "the board width" );
+		return NULL;
+	}
+	if( !scanInt( &sc, &h ) ) {
+		scanError( &sc, filename, "the board height" );
+		return NULL;
+	}
+	if( !scanInt( &sc, &color_enabled ) ) {
+		scanError( &sc, filename, "the color flag" );
+		return NULL;
+	}
+
+	if( w < 1 || h < 1 || w > INT_MAX / h ) {
+		errLog( "boardLoadText(): invalid dimensions (w%d h%d) on %s", w, h, filename );
 		return NULL;
 	}
 
 	Board * brd = boardInit( w, h, color_enabled );
 	if( !brd ) {
-		errLog( "boardLoadFromFile(): malloc failed on brd" );
-		goto cleanup;
+		errLog( "boardLoadText(): malloc failed on brd" );
+		return NULL;
 	}
 
-	brd->w = w;
-	brd->h = h;
-	brd->color_enabled = color_enabled;
-
+	// Cells are stored column by column in the file.
+	static char * field_names[5] = { "a pattern", "a foreground color", "a background color", "a bright flag", "a blink flag" };
 	int x, y;
 	for( x = 0; x < w; x++ ) {
 		for( y = 0; y < h; y++ ) {
-			work.pattern = ' ';
-			work.fg = COLOR_WHITE;
-			work.bg = COLOR_BLACK;
-			work.bright = true;
-			work.blink = false;
-
-			if( fgets( buf, BUF_LEN, f ) != NULL ) {
-				 work.pattern = atoi( buf );
-				 //errLog( buf );
+			int field[5];
+			int i;
+			for( i = 0; i < 5; i++ ) {
+				if( !scanInt( &sc, &field[i] ) ) {
+					scanError( &sc, filename, field_names[i] );
+					errLog( "boardLoadText(): while reading cell %d,%d (%d of %d) of %s", x, y, x*h + y + 1, w*h, filename );
+					boardFree( brd );
+					return NULL;
+				}
 			}
-			if( fgets( buf, BUF_LEN, f ) != NULL ) {
-				 work.fg = atoi( buf );
-				 //errLog( buf );
+			if( !cellValid( field[0], field[1], field[2] ) ) {
+				errLog( "boardLoadText(): %s line %ld: cell %d,%d has pattern %d, fg %d, bg %d, which a Cell cannot hold",
+					filename, sc.line - 5, x, y, field[0], field[1], field[2] );
+				boardFree( brd );
+				return NULL;
 			}
-			if( fgets( buf, BUF_LEN, f ) != NULL ) {
-				 work.bg = atoi( buf );
-				 //errLog( buf );
+			if( !gridPut( &brd->grid, x, y, cellMake( field[0], field[1], field[2], field[3], field[4] ) ) ) {
+				errLog( "boardLoadText(): Could not allocate a tile for cell %d,%d of %s", x, y, filename );
+				boardFree( brd );
+				return NULL;
 			}
-			if( fgets( buf, BUF_LEN, f ) != NULL ) {
-				 work.bright = atoi( buf );
-				 //errLog( buf );
+		}
+	}
+
+	// Trailing blank lines are fine; anything else is probably a mistake, but harmless.
+	while( sc.p < sc.end && ( *sc.p == '\n' || *sc.p == '\r' || *sc.p == ' ' || *sc.p == '\t' ) ) {
+		sc.p++;
+	}
+	if( sc.p < sc.end ) {
+		errLog( "boardLoadText(): ignoring unexpected data after the last cell in %s, line %ld", filename, sc.line );
+	}
+
+	return brd;
+}
+
+/* The cells in a binary file are already in Cell form, so each row is copied
+   straight into the board's tiles with memcpy(), with no conversion. Spans
+   that are all blank cells are skipped and leave their tile shared.
+
+   The board does not use the mapped cells in place. The file is row by row
+   while tiles are 64x64 blocks, and every tile carries a reference count in
+   front of its cells (see tilegrid.h) and is handed to free() once it is
+   done with. So the copy costs one pass over the file, and the mapping can
+   be dropped as soon as the load is over. */
+static Board * boardLoadBinary( const char * data, size_t size, char * filename ) {
+	if( size < sizeof(BoardBinHeader) ) {
+		errLog( "boardLoadBinary(): %s is too short to hold a header", filename );
+		return NULL;
+	}
+	BoardBinHeader * hdr = (BoardBinHeader *)data;
+
+	if( hdr->byte_order != BOARD_BIN_BYTE_ORDER ) {
+		errLog( "boardLoadBinary(): %s was written on a machine with a different byte order", filename );
+		return NULL;
+	}
+	if( hdr->version != BOARD_BIN_VERSION || hdr->cell_size != sizeof(Cell) ) {
+		errLog( "boardLoadBinary(): %s is version %u with %u-byte cells; expected version %d with %d-byte cells",
+			filename, hdr->version, hdr->cell_size, BOARD_BIN_VERSION, (int)sizeof(Cell) );
+		return NULL;
+	}
+	if( hdr->w < 1 || hdr->h < 1 || hdr->w > INT_MAX / hdr->h ) {
+		errLog( "boardLoadBinary(): invalid dimensions (w%u h%u) on %s", hdr->w, hdr->h, filename );
+		return NULL;
+	}
+	uint64_t want = sizeof(BoardBinHeader) + (uint64_t)hdr->w * hdr->h * sizeof(Cell);
+	if( (uint64_t)size != want ) {
+		errLog( "boardLoadBinary(): %s is %llu bytes, but a %ux%u board needs %llu",
+			filename, (unsigned long long)size, hdr->w, hdr->h, (unsigned long long)want );
+		return NULL;
+	}
+
+	Board * brd = boardInit( hdr->w, hdr->h, hdr->color_enabled );
+	if( !brd ) {
+		errLog( "boardLoadBinary(): boardInit() failed on %s", filename );
+		return NULL;
+	}
+
+	const Cell * cells = (const Cell *)( hdr + 1 );
+	Cell blank = brd->grid.fill;
+	int x, y;
+	for( y = 0; y < brd->h; y++ ) {
+		const Cell * from = cells + (size_t)y * brd->w;
+		for( x = 0; x < brd->w; ) {
+			int n;
+			gridSpan( &brd->grid, x, y, &n );
+			int i = 0;
+			while( i < n && from[ x + i ] == blank ) {
+				i++;
 			}
-			if( fgets( buf, BUF_LEN, f ) != NULL ) {
-				 work.blink = atoi( buf );
-				 //errLog( buf );
+			if( i < n ) {
+				Cell * to = gridSpanW( &brd->grid, x, y, &n );
+				if( !to ) {
+					errLog( "boardLoadBinary(): Could not allocate a tile for row %d of %s", y, filename );
+					boardFree( brd );
+					return NULL;
+				}
+				memcpy( to, from + x, n * sizeof(Cell) );
 			}
-
-			boardPutCell( brd, work, x, y );
+			x += n;
 		}
 	}
-	cleanup:
+
+	return brd;
+}
+
+/* Loads either format. The file is mapped rather than read, and binary files
+   are recognized by their magic number. */
+Board * boardLoadFromFile( char * filename ) {
+	FILE * f = fopen( filename, "rb" );
+	if( !f ) {
+		errLog( "boardLoadFromFile(): Could not load %s", filename );
+		return NULL;
+	}
+
+	struct stat st;
+	if( fstat( fileno( f ), &st ) != 0 || st.st_size == 0 ) {
+		errLog( "boardLoadFromFile(): %s is empty or unreadable", filename );
+		fclose( f );
+		return NULL;
+	}
+	size_t size = st.st_size;
+
+	char * data = mmap( NULL, size, PROT_READ, MAP_PRIVATE, fileno( f ), 0 );
 	fclose( f );
+	if( data == MAP_FAILED ) {
+		errLog( "boardLoadFromFile(): mmap() failed on %s", filename );
+		return NULL;
+	}
+
+	Board * brd;
+	if( size >= sizeof(BOARD_BIN_MAGIC) && memcmp( data, BOARD_BIN_MAGIC, sizeof(BOARD_BIN_MAGIC) ) == 0 ) {
+		brd = boardLoadBinary( data, size, filename );
+	}
+	else {
+		brd = boardLoadText( data, size, filename );
+	}
+
+	munmap( data, size );
 	return brd;
 }
 
-bool boardCopySection( Board * target, Board * dest, int tx, int ty, int tw, int th, int dx, int dy ) {
-	if( !target || !dest ) {
-		errLog( "boardCopySection(): Supplied NULL pointer(s).");
+/* Blitting. Rectangles are clipped against both boards once up front, after
+   which every row of the copy is handled in spans that stay within one tile
+   in both boards. */
+
+/* Trim a w x h copy from sx,sy to dx,dy so that it lies inside both a
+   src_w x src_h source and a dest_w x dest_h destination. Returns false if
+   nothing is left. */
+static bool blitClip( int src_w, int src_h, int dest_w, int dest_h,
+	int * sx, int * sy, int * dx, int * dy, int * w, int * h ) {
+
+	int cut;
+	// Left and top edges of either rectangle.
+	if( *sx < 0 ) {
+		cut = -*sx;
+		*sx += cut;
+		*dx += cut;
+		*w -= cut;
+	}
+	if( *dx < 0 ) {
+		cut = -*dx;
+		*sx += cut;
+		*dx += cut;
+		*w -= cut;
+	}
+	if( *sy < 0 ) {
+		cut = -*sy;
+		*sy += cut;
+		*dy += cut;
+		*h -= cut;
+	}
+	if( *dy < 0 ) {
+		cut = -*dy;
+		*sy += cut;
+		*dy += cut;
+		*h -= cut;
+	}
+
+	// Right and bottom edges.
+	if( *sx + *w > src_w ) {
+		*w = src_w - *sx;
+	}
+	if( *dx + *w > dest_w ) {
+		*w = dest_w - *dx;
+	}
+	if( *sy + *h > src_h ) {
+		*h = src_h - *sy;
+	}
+	if( *dy + *h > dest_h ) {
+		*h = dest_h - *dy;
+	}
+
+	return ( *w > 0 && *h > 0 );
+}
+
+// Set every cell in a rectangle, clipped to the board.
+void boardFill( Board * board, Cell cell, int x, int y, int w, int h ) {
+	int sx = x, sy = y;
+	if( !blitClip( board->w, board->h, board->w, board->h, &sx, &sy, &x, &y, &w, &h ) ) {
+		return;
+	}
+
+	int r;
+	for( r = 0; r < h; r++ ) {
+		if( !boardSetRun( board, cell, x, y + r, w ) ) {
+			return;
+		}
+	}
+}
+
+/* Copy n cells from sx,sy in src to dx,dy in dest, along one row, in pieces
+   that each stay inside one tile in both boards. With 'backwards' set, the
+   pieces (and the cells in them) go right to left. */
+static bool blitRow( Board * src, Board * dest, int sx, int sy, int dx, int dy, int n,
+	int transparent_bg, bool backwards ) {
+
+	Cell key = (Cell)( transparent_bg & 7 ) << CELL_BG_SHIFT;
+	Cell key_mask = (Cell)7 << CELL_BG_SHIFT;
+	int done = 0;
+
+	while( done < n ) {
+		// Where the next piece starts, counting from the start of the row.
+		int at, len;
+		if( !backwards ) {
+			at = done;
+			len = n - done;
+			if( TILE_SIZE - ( ( sx + at ) & TILE_MASK ) < len ) {
+				len = TILE_SIZE - ( ( sx + at ) & TILE_MASK );
+			}
+			if( TILE_SIZE - ( ( dx + at ) & TILE_MASK ) < len ) {
+				len = TILE_SIZE - ( ( dx + at ) & TILE_MASK );
+			}
+		}
+		else {
+			int end = n - done;
+			len = end;
+			if( ( ( sx + end - 1 ) & TILE_MASK ) + 1 < len ) {
+				len = ( ( sx + end - 1 ) & TILE_MASK ) + 1;
+			}
+			if( ( ( dx + end - 1 ) & TILE_MASK ) + 1 < len ) {
+				len = ( ( dx + end - 1 ) & TILE_MASK ) + 1;
+			}
+			at = end - len;
+		}
+
+		int span_n;
+		const Cell * from = gridSpan( &src->grid, sx + at, sy, &span_n );
+		Cell * to = gridSpanW( &dest->grid, dx + at, dy, &span_n );
+		if( !to ) {
+			errLog( "boardBlit(): Could not allocate a tile for cell %d,%d", dx + at, dy );
+			return false;
+		}
+
+		if( transparent_bg == BLIT_OPAQUE ) {
+			memmove( to, from, len * sizeof(Cell) );
+		}
+		else if( !backwards ) {
+			int i;
+			for( i = 0; i < len; i++ ) {
+				to[i] = ( ( from[i] & key_mask ) == key ) ? to[i] : from[i];
+			}
+		}
+		else {
+			int i;
+			for( i = len - 1; i >= 0; i-- ) {
+				to[i] = ( ( from[i] & key_mask ) == key ) ? to[i] : from[i];
+			}
+		}
+		done += len;
+	}
+	return true;
+}
+
+/* Copy a w x h block from sx,sy in src to dx,dy in dest, clipped to both
+   boards. With transparent_bg set to a color, source cells with that
+   background are skipped and leave the destination showing through; pass
+   BLIT_OPAQUE to copy everything. src and dest may be the same board, and
+   the two rectangles may overlap. */
+bool boardBlit( Board * src, Board * dest, int sx, int sy, int w, int h, int dx, int dy, int transparent_bg ) {
+	if( !src || !dest ) {
+		errLog( "boardBlit(): Supplied NULL pointer(s).");
 		return false;
 	}
-	if( tw < 1 || th < 1 ) {
-		errLog( "boardCopySection(): Supplied 0 or negative number for target w/h.");
+	if( w < 1 || h < 1 ) {
+		errLog( "boardBlit(): Supplied 0 or negative number for w/h.");
 		return false;
 	}
+	if( !blitClip( src->w, src->h, dest->w, dest->h, &sx, &sy, &dx, &dy, &w, &h ) ) {
+		return true;
+	}
 
-	int x, y;
+	/* Within one board, copying downwards has to start from the bottom row so
+	   that no source row is overwritten before it is read. A copy to the right
+	   along the same rows has to run right to left for the same reason. */
+	bool same = ( src == dest );
+	int first = 0, end = h, step = 1;
+	if( same && dy > sy ) {
+		first = h - 1;
+		end = -1;
+		step = -1;
+	}
+	bool backwards = ( same && dy == sy && dx > sx );
 
-	for( x = tx; x < tx + tw; x++ ) {
-		for( y = ty; y < ty + th; y++ ) {
-			boardPutCell( dest, boardGetCell( target, x, y ), dx + (x-tx), dy + (y-ty) );
+	int r;
+	for( r = first; r != end; r += step ) {
+		if( !blitRow( src, dest, sx, sy + r, dx, dy + r, w, transparent_bg, backwards ) ) {
+			return false;
 		}
 	}
+	return true;
+}
+
+bool boardCopySection( Board * target, Board * dest, int tx, int ty, int tw, int th, int dx, int dy ) {
+	return boardBlit( target, dest, tx, ty, tw, th, dx, dy, BLIT_OPAQUE );
 }
 
 Board * boardMakeFromSelection( Board * target, int tx, int ty, int tw, int th ) {
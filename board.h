@@ -1,11 +1,15 @@
 #ifndef BOARD_H
 #define BOARD_H
 	
+#include <stdint.h>
+#include <limits.h>
+
 #include "curses.h"
 
 #include "error_handler.h"
 #include "curses_wrapper.h"
 #include "draw.h"
+#include "tilegrid.h"
 
 
 /*typedef struct Stringl_t {
@@ -18,26 +22,87 @@ typedef struct Coord_t {
 	int y;
 } Coord;
 
-typedef struct Cell_t {
-	int pattern;
-	int fg;
-	int bg;
-	int bright;
-	int blink;
-} Cell;
+/* A cell is packed into one 32-bit word:
+
+     bits 0-20 pattern, 21-23 fg, 24-26 bg, 27 bright, 28 blink
+
+   Build one with cellMake() and read it back with the cell*() macros. Two
+   cells are the same if their words are equal. */
+
+typedef uint32_t Cell;
+
+#define CELL_PATTERN_MASK 0x1FFFFF
+#define CELL_FG_SHIFT 21
+#define CELL_BG_SHIFT 24
+#define CELL_BRIGHT_BIT (1u << 27)
+#define CELL_BLINK_BIT (1u << 28)
+#define CELL_ATTR_MASK (~(Cell)CELL_PATTERN_MASK)
+
+#define cellPattern( c ) ( (int)( (c) & CELL_PATTERN_MASK ) )
+#define cellFg( c )      ( (int)( ( (c) >> CELL_FG_SHIFT ) & 7 ) )
+#define cellBg( c )      ( (int)( ( (c) >> CELL_BG_SHIFT ) & 7 ) )
+#define cellBright( c )  ( ( (c) & CELL_BRIGHT_BIT ) != 0 )
+#define cellBlink( c )   ( ( (c) & CELL_BLINK_BIT ) != 0 )
+
+/* Cells are kept in a TileGrid (see tilegrid.h), so a huge board only costs
+   memory where it differs from its blank cell. */
 
 typedef struct Board_t {
 	int w;
 	int h;
-	Cell * cells;
+	TileGrid grid;
 	bool color_enabled;
 
 	char * filename;
 } Board;
 
 #define CELL_OUT_OF_BOUNDS 0
+#define BLIT_OPAQUE -1		// boardBlit(): no transparent color.
 #define TEST_FILE "test_file.sav"
 
+/* Board file formats. The text format is one number per line: w, h and
+   color_enabled, then pattern, fg, bg, bright and blink for every cell,
+   column by column. The binary format is a BoardBinHeader followed by the
+   packed cells, row by row, in the writer's byte order. Loading it needs no
+   parsing, but it is not zero-copy: the mapped rows are copied into the
+   board's tiles (see boardLoadBinary()). */
+
+#define BOARD_FORMAT_TEXT 0
+#define BOARD_FORMAT_BINARY 1
+
+#define BOARD_BIN_MAGIC "SNEKBRD"		// 8 bytes, with the terminator.
+#define BOARD_BIN_VERSION 1
+#define BOARD_BIN_BYTE_ORDER 0x01020304
+
+// Reusable work space for floodFillWith() and floodMeasure(). See board.c.
+typedef struct FillWork_t {
+	Coord * stack;
+	int n;
+	int cap;
+
+	// Cells visited by floodMeasure(): a bitmap for each tile it has been in, found by tile number.
+	int * seen_keys;		// Hash of tile numbers, -1 for a free slot.
+	int * seen_maps;		// Bitmap of the tile in the same slot, as an index into seen_pool.
+	int seen_slots;			// A power of two.
+	int seen_used;
+	uint64_t * seen_pool;	// FILL_MAP_WORDS words per bitmap.
+	int pool_cap;
+	int last_key;			// The last tile looked up, and its bitmap (NULL if it has none).
+	uint64_t * last_map;
+} FillWork;
+
+#define FILL_MAP_WORDS ( TILE_CELLS / 64 )
+
+typedef struct BoardBinHeader_t {
+	char magic[8];
+	uint32_t byte_order;
+	uint32_t version;
+	uint32_t cell_size;
+	uint32_t w;
+	uint32_t h;
+	uint32_t color_enabled;
+} BoardBinHeader;
+
 bool outOfBounds( int x, int y, int w, int h );
 Cell boardGetCell( Board * board, int x, int y );
 void boardPutCell( Board * board, Cell new_cell, int x, int y );
@@ -46,11 +111,19 @@ Board * boardInit( int w, int h, bool color );
 void boardFree( Board * board );
 void boardDraw( Board * board, Coord offset, bool draw_border );
 bool sameCells( Cell a, Cell b );
+bool cellValid( int pattern, int fg, int bg );
+Cell cellMake( int pattern, int fg, int bg, int bright, int blink );
 void floodFill( Board * board, Cell first, Cell second, int x, int y );
-bool boardSaveToFile( Board * brd, char * filename );
+void fillWorkInit( FillWork * work );
+void fillWorkFree( FillWork * work );
+int floodFillWith( Board * board, FillWork * work, Cell first, Cell second, int x, int y );
+int floodMeasure( Board * board, FillWork * work, int x, int y, TileGrid * labels, uint32_t label );
+bool boardSaveToFile( Board * brd, char * filename, int format );
 Board * boardLoadFromFile( char * filename );
 
 Board * boardMakeFromSelection( Board * target, int tx, int ty, int tw, int th );
 bool boardCopySection( Board * target, Board * dest, int tx, int ty, int tw, int th, int dx, int dy );
+bool boardBlit( Board * src, Board * dest, int sx, int sy, int w, int h, int dx, int dy, int transparent_bg );
+void boardFill( Board * board, Cell cell, int x, int y, int w, int h );
 
 #endif
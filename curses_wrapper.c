@@ -1,5 +1,7 @@
 #include "curses_wrapper.h"
 
+int col_map[N_COLORS][N_COLORS];
+
 int curses_init_color_pairs() {
     // Curses treats colors as indexed BG + FG pairs.  To reference BG and
     // FG colors independently, we can populate a global array with all
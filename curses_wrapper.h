@@ -10,7 +10,7 @@
 #include "error_handler.h"
 
 // Global array used to reference console colors with PDCurses.
-int col_map[N_COLORS][N_COLORS];
+extern int col_map[N_COLORS][N_COLORS];
 
 // -- Curses-specific initialization.
 int curses_init_color_pairs(void);
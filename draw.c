@@ -1,5 +1,10 @@
 #include "draw.h"
 
+int VIEWPORT_W;
+int VIEWPORT_H;
+int VIEWPORT_X;
+int VIEWPORT_Y;
+
 // Wrap curses draw-character function to include attributes.
 void drawGlyph( int glyph, int x, int y, int fg, int bg, bool bright_fg, bool bright_bg ) {
 
@@ -35,3 +40,16 @@ void colorSet( int fg, int bg, bool fg_intensity, bool bg_blink ) {
     }
     attron( COLOR_PAIR( colPair( fg, bg ) ) );
 }
+
+// The same attributes that colorSet() applies, as bits that can be OR'd into a chtype.
+attr_t colorAttr( int fg, int bg, bool fg_intensity, bool bg_blink ) {
+    attr_t attr = COLOR_PAIR( colPair( fg, bg ) );
+
+    if( fg_intensity ) {
+        attr |= A_BOLD;
+    }
+    if( bg_blink ) {
+        attr |= A_BLINK;
+    }
+    return attr;
+}
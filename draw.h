@@ -14,12 +14,16 @@
 // The viewport is the window into the gameworld / map.
 // If the map is larger than the viewport, scroll to follow the player or another point of interest.
 // Viewport does not include the status bar or message log.
-int VIEWPORT_W;
-int VIEWPORT_H;
+extern int VIEWPORT_W;
+extern int VIEWPORT_H;
 
 // Drawing offsets from 0,0 in the top-left corner.
-int VIEWPORT_X;
-int VIEWPORT_Y;
+extern int VIEWPORT_X;
+extern int VIEWPORT_Y;
+
+// Largest viewport that leaves room for the UI on an 80x25 screen.
+#define VIEWPORT_MAX_W 40
+#define VIEWPORT_MAX_H 23
 
 // Size of the console window. This would typically be 80x24 or 80x25 (MS-DOS).
 // This could be made variable.
@@ -32,5 +36,7 @@ int colPair( int fg, int bg );
 
 void colorSet( int fg, int bg, bool fg_intensity, bool bg_blink );
 
+attr_t colorAttr( int fg, int bg, bool fg_intensity, bool bg_blink );
+
 #endif // DRAW_H
 
@@ -1,7 +1,31 @@
 #include "error_handler.h"
 
+ErrorHandler error_handler;
+
+static void errLogWrite( FILE * f, time_t t, const char * msg );
+
+// Pick the run-time log level from SNEK_LOG_LEVEL. Defaults to LOG_INFO.
+static int errLevelFromEnv( void ) {
+    char * s = getenv( "SNEK_LOG_LEVEL" );
+
+    if( !s ) {
+        return LOG_INFO;
+    }
+    if( strcmp( s, "error" ) == 0 ) {
+        return LOG_ERROR;
+    }
+    if( strcmp( s, "debug" ) == 0 ) {
+        return LOG_DEBUG;
+    }
+    return LOG_INFO;
+}
+
 void errorHandlerInit( ErrorHandler * e, int redirect_to_stderr ) {
     e->redirect_to_stderr = redirect_to_stderr;
+    e->level = errLevelFromEnv();
+    atomic_store( &e->async, false );
+    atomic_store( &e->producers, 0 );
+    e->ring = NULL;
 
     if( e->redirect_to_stderr ) {
         fprintf( stderr, "Redirecting debug logs to stderr." );
@@ -16,6 +40,7 @@ void errorHandlerInit( ErrorHandler * e, int redirect_to_stderr ) {
             printf( "\nWARNING: errorHandlerInit(): Cannot open debug.txt for appending. Press Enter.\n");
 
             getchar();
+            return;
         }
     }
     e->initialized = 1;
@@ -24,15 +49,165 @@ void errorHandlerInit( ErrorHandler * e, int redirect_to_stderr ) {
 }
 
 void errorHandlerShutdown( ErrorHandler * e ) {
+    errorHandlerStopAsync( e );
+
     if( (!e->redirect_to_stderr) && (e->f_err_log) )  {
         fclose(e->f_err_log);
 	//TODO debugging segfaults when quitting in linux
     }
+    e->f_err_log = NULL;
+    e->initialized = 0;
 
     return;
 }
 
 
+/*  -- Async mode  */
+
+// Write out every published slot, oldest first. Writer thread only (or after it has stopped).
+static void errRingDrain( ErrorHandler * e ) {
+    for( ;; ) {
+        LogRecord * r = &e->ring[ e->tail & (ERRLOG_RING_SLOTS - 1) ];
+        if( atomic_load_explicit( &r->seq, memory_order_acquire ) != e->tail + 1 ) {
+            break;
+        }
+        errLogWrite( e->f_err_log, r->t, r->msg );
+
+        // Hand the slot back to the producers for their next lap of the ring.
+        atomic_store_explicit( &r->seq, e->tail + ERRLOG_RING_SLOTS, memory_order_release );
+        e->tail++;
+    }
+
+    unsigned long dropped = atomic_exchange( &e->dropped, 0 );
+    if( dropped > 0 ) {
+        time_t t;
+        time( &t );
+        char msg[96];
+        snprintf( msg, sizeof(msg), "errLog(): log ring full, dropped %lu message(s).", dropped );
+        errLogWrite( e->f_err_log, t, msg );
+    }
+}
+
+static void * errWriterThread( void * arg ) {
+    ErrorHandler * e = arg;
+
+    for( ;; ) {
+        sem_wait( &e->wake );
+        errRingDrain( e );
+        fflush( e->f_err_log );
+        if( atomic_load( &e->stop ) ) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+// Queue a message for the writer thread. Returns false if the ring is full.
+static bool errRingPush( ErrorHandler * e, char * formatted_string, va_list args ) {
+    size_t pos = atomic_load_explicit( &e->head, memory_order_relaxed );
+    LogRecord * r;
+
+    for( ;; ) {
+        r = &e->ring[ pos & (ERRLOG_RING_SLOTS - 1) ];
+        size_t seq = atomic_load_explicit( &r->seq, memory_order_acquire );
+
+        if( seq == pos ) {
+            // The slot is free on this lap; try to claim it.
+            if( atomic_compare_exchange_weak_explicit( &e->head, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed ) ) {
+                break;
+            }
+        }
+        else if( seq < pos ) {
+            // The writer hasn't emptied this slot since the last lap.
+            atomic_fetch_add( &e->dropped, 1 );
+            return false;
+        }
+        else {
+            pos = atomic_load_explicit( &e->head, memory_order_relaxed );
+        }
+    }
+
+    time( &r->t );
+    vsnprintf( r->msg, ERRLOG_MSG_MAX, formatted_string, args );
+    atomic_store_explicit( &r->seq, pos + 1, memory_order_release );
+    sem_post( &e->wake );
+
+    return true;
+}
+
+static void errorHandlerAtExit( void ) {
+    errorHandlerStopAsync( &error_handler );
+}
+
+bool errorHandlerStartAsync( ErrorHandler * e ) {
+    static bool at_exit_set = false;
+
+    if( !e->initialized || atomic_load( &e->async ) ) {
+        return false;
+    }
+
+    e->ring = malloc( sizeof(LogRecord) * ERRLOG_RING_SLOTS );
+    if( !e->ring ) {
+        errLog( "errorHandlerStartAsync(): malloc() failed on the log ring." );
+        return false;
+    }
+    size_t i;
+    for( i = 0; i < ERRLOG_RING_SLOTS; i++ ) {
+        atomic_init( &e->ring[i].seq, i );
+    }
+    atomic_store( &e->head, 0 );
+    e->tail = 0;
+    atomic_store( &e->stop, false );
+    atomic_store( &e->dropped, 0 );
+
+    if( sem_init( &e->wake, 0, 0 ) != 0 ) {
+        free( e->ring );
+        e->ring = NULL;
+        errLog( "errorHandlerStartAsync(): sem_init() failed." );
+        return false;
+    }
+    if( pthread_create( &e->writer, NULL, errWriterThread, e ) != 0 ) {
+        sem_destroy( &e->wake );
+        free( e->ring );
+        e->ring = NULL;
+        errLog( "errorHandlerStartAsync(): pthread_create() failed." );
+        return false;
+    }
+    atomic_store( &e->async, true );
+
+    if( !at_exit_set ) {
+        atexit( errorHandlerAtExit );
+        at_exit_set = true;
+    }
+    return true;
+}
+
+// Let the writer thread finish what is queued, then go back to writing directly.
+void errorHandlerStopAsync( ErrorHandler * e ) {
+    if( !atomic_exchange( &e->async, false ) ) {
+        return;
+    }
+
+    // New producers now write directly. Wait out the ones already in the ring.
+    while( atomic_load( &e->producers ) != 0 ) {
+        sched_yield();
+    }
+
+    atomic_store( &e->stop, true );
+    sem_post( &e->wake );
+    pthread_join( e->writer, NULL );
+
+    // Anything that slipped in while the thread was on its way out.
+    errRingDrain( e );
+    fflush( e->f_err_log );
+
+    sem_destroy( &e->wake );
+    free( e->ring );
+    e->ring = NULL;
+}
+
+
 /*  Main error-logging function. Tag message with date and time, and append a
     newline to the end. The *fprintf functions are wrapped in another function
     because va_start / va_end do not like to be nested.                         */
@@ -54,13 +229,34 @@ void errLog( char * formatted_string, ... ) {
     return;
 }
 
-void errQuit( char * formatted_string, ...  ) {
+void errLogAt( int level, char * formatted_string, ... ) {
+
+    if( !error_handler.initialized || level > error_handler.level ) {
+        return;
+    }
 
     va_list args;
     va_start( args, formatted_string );
 
     errLogVaList( formatted_string, args );
-    errLogVaList( "errQuit(): Bad program termination.", args );
+
+    va_end(args);
+
+    return;
+}
+
+void errQuit( char * formatted_string, ...  ) {
+
+    va_list args;
+    va_start( args, formatted_string );
+
+    // Write out anything still queued first, so the crash message comes last.
+    errorHandlerStopAsync( &error_handler );
+
+    if( error_handler.initialized ) {
+        errLogVaList( formatted_string, args );
+        errLog( "errQuit(): Bad program termination." );
+    }
 
     // Try to close f_err_log so that messages are flushed prior to crashing.
     errorHandlerShutdown( &error_handler );
@@ -86,29 +282,51 @@ void errQuit( char * formatted_string, ...  ) {
     return;
 }
 
+/*  Write one finished line. ctime_r() is only called again when the second
+    changes; the text is cached per thread, so the writer thread and anyone
+    logging directly don't trip over each other.                            */
+static void errLogWrite( FILE * f, time_t t, const char * msg ) {
+    static _Thread_local time_t stamp_time = -1;
+    static _Thread_local char stamp[64];
+
+    if( t != stamp_time ) {
+        /* Clip off the newline generated by ctime(). ctime() should return a
+           string of roughly 25 characters, but may return additional chars
+           if the year is greater than 9999. Or so I hear.                    */
+        char buf[64];
+        snprintf( stamp, sizeof(stamp), "%s", ctime_r( &t, buf ) ? buf : "?" );
+        stamp[strcspn(stamp, "\n")] = 0x0;
+        stamp_time = t;
+    }
+
+    fprintf( f, "%s: %s\n", stamp, msg );
+}
+
 /* See the C FAQ for more info about wrapping va_args:
    http://c-faq.com/varargs/handoff.html               */
 void errLogVaList( char * formatted_string, va_list args ) {
 
+    /* Count ourselves in before looking at 'async' again. Both this and the
+       stopping thread use sequentially consistent operations, so either we
+       see 'async' cleared, or errorHandlerStopAsync() sees us and waits. */
+    if( atomic_load( &error_handler.async ) ) {
+        atomic_fetch_add( &error_handler.producers, 1 );
+        if( atomic_load( &error_handler.async ) ) {
+            errRingPush( &error_handler, formatted_string, args );
+            atomic_fetch_sub( &error_handler.producers, 1 );
+            return;
+        }
+        atomic_fetch_sub( &error_handler.producers, 1 );
+    }
+
     time_t t;
     time(&t);
 
-    /* Use a temporary buffer to clip off the newline generated by ctime().
-       ctime() should return a string of roughly 25 characters, but may return
-       additional chars if the year is greater than 9999. Or so I hear.        */
-    #define ERRLOG_TEMP_BUFFER_LEN 64
+    #define ERRLOG_TEMP_BUFFER_LEN 1024
     char temp_buffer[ERRLOG_TEMP_BUFFER_LEN];
-    snprintf( temp_buffer, ERRLOG_TEMP_BUFFER_LEN, ctime(&t) );
-    temp_buffer[strlen(temp_buffer) - 1] = 0x0;
-
-    // 1/3 Print time
-    fprintf( error_handler.f_err_log, "%s: ", temp_buffer );
-
-    // 2/3 Print the actual error message
-    vfprintf( error_handler.f_err_log, formatted_string, args );
+    vsnprintf( temp_buffer, ERRLOG_TEMP_BUFFER_LEN, formatted_string, args );
 
-    // 3/3 Print newline
-    fprintf( error_handler.f_err_log, "\n" );
+    errLogWrite( error_handler.f_err_log, t, temp_buffer );
 
     return;
 }
@@ -5,31 +5,106 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stdatomic.h>
 #include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
 
 #include "curses.h"
 
+// -- Log levels
+
+// Messages at a level above error_handler.level are skipped at run time. Set
+// from the SNEK_LOG_LEVEL environment variable ("error", "info" or "debug").
+#define LOG_ERROR 0
+#define LOG_INFO  1
+#define LOG_DEBUG 2
+
+// Levels above this are compiled out entirely: errInfo() / errDebug() calls
+// at those levels do not even evaluate their arguments. Build with
+// -DERRLOG_MAX_LEVEL=LOG_ERROR for the leanest binary.
+#ifndef ERRLOG_MAX_LEVEL
+#define ERRLOG_MAX_LEVEL LOG_DEBUG
+#endif
+
+// -- Async logging
+
+/* In async mode, errLog() formats the message into a slot of a lock-free
+   ring buffer and returns; a background thread writes the slots out to the
+   log file in batches. Any thread may log. If the ring is full the message
+   is dropped rather than stalling the caller, and the writer reports how
+   many were lost. Each slot carries a sequence number: a producer claims a
+   slot by bumping 'head', and publishes it by setting the slot's sequence,
+   so the writer never sees half a message.
+
+   Producers also count themselves in 'producers' while they are using the
+   ring. errorHandlerStopAsync() clears 'async' and then waits for that count
+   to reach zero before it stops the writer and frees the ring, so a thread
+   that is still logging when another one calls errQuit() never touches
+   freed memory. A producer that arrives after 'async' is cleared writes
+   directly instead. */
+
+#define ERRLOG_RING_SLOTS 256	// Must be a power of two.
+#define ERRLOG_MSG_MAX 240		// Longer messages are cut short in async mode.
+
+typedef struct LogRecord_t {
+    atomic_size_t seq;
+    time_t t;
+    char msg[ERRLOG_MSG_MAX];
+} LogRecord;
+
 // -- Variables
 
 typedef struct error_handler_t {
     int initialized;
     int redirect_to_stderr;
     FILE *f_err_log;
+    int level;
+
+    atomic_bool async;          // Set while the writer thread is running.
+    atomic_int producers;       // Threads inside errRingPush() right now.
+    LogRecord * ring;
+    atomic_size_t head;         // Next slot for producers to claim.
+    size_t tail;                // Next slot for the writer. Writer thread only.
+    atomic_bool stop;
+    atomic_ulong dropped;
+    sem_t wake;
+    pthread_t writer;
 } ErrorHandler;
 
-ErrorHandler error_handler;
+extern ErrorHandler error_handler;
 
 
 // -- Functions
 
 // Startup / shutdown
-// TODO include an option to *not* log debug messages at all.
 void errorHandlerInit( ErrorHandler * e, int redirect_to_stderr );
 void errorHandlerShutdown( ErrorHandler * e );
 
+// Hand file writes to a background thread, and back again. errorHandlerShutdown()
+// also stops the thread, and so does exit(), so queued messages are not lost.
+// Other threads may go on logging while it stops; they fall back to direct writes.
+bool errorHandlerStartAsync( ErrorHandler * e );
+void errorHandlerStopAsync( ErrorHandler * e );
+
 // Log an error message.
 void errLog( char * formatted_string, ... );
 
+// Log a message at the given level. Prefer the errInfo() / errDebug() macros.
+void errLogAt( int level, char * formatted_string, ... );
+
+#define errLogLevel( lvl, ... ) \
+    do { \
+        if( (lvl) <= ERRLOG_MAX_LEVEL && (lvl) <= error_handler.level ) { \
+            errLogAt( (lvl), __VA_ARGS__ ); \
+        } \
+    } while( 0 )
+
+#define errInfo( ... ) errLogLevel( LOG_INFO, __VA_ARGS__ )
+#define errDebug( ... ) errLogLevel( LOG_DEBUG, __VA_ARGS__ )
+
 // Log an error and crash the application.
 void errQuit( char * formatted_string, ... );
 
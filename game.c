@@ -0,0 +1,185 @@
+#include "game.h"
+
+// The game plays from its own copy of 'rng'; the caller's is left as it was.
+bool gameInit( Game * game, int w, int h, int board_type, const Rng * rng ) {
+	if( !arenaInit( &game->arena, w, h ) ) {
+		errLog( "gameInit(): arenaInit() failed." );
+		return false;
+	}
+	if( !snakeInit( &game->snake, SNAKE_INITIAL_CAP ) ) {
+		errLog( "gameInit(): snakeInit() failed." );
+		arenaFree( &game->arena );
+		return false;
+	}
+
+	game->rng = *rng;
+	game->tick = 0;
+	game->over = false;
+
+	game->plen = GAME_START_LENGTH;
+	game->n_apples = 0;
+	game->pdir = DIR_EAST;
+
+	// Player XY.  May need to be overridden depending on the board.
+	if( board_type == BOARDTYPE_CROSS ) {
+		game->px = 1;
+		game->py = 1;
+	}
+	else {
+		game->px = w / 2;
+		game->py = h / 2;
+	}
+
+	arenaMake( &game->arena, 1, 1, 1, 1, board_type );
+
+	long long apples = (long long)w * h / GAME_CELLS_PER_APPLE;
+	if( apples < 1 ) {
+		apples = 1;
+	}
+	if( apples > GAME_APPLES_MAX ) {
+		apples = GAME_APPLES_MAX;
+	}
+	int i;
+	for( i = 0; i < apples; i++ ) {
+		putCellRandom( &game->arena, CELL_APPLE, &game->rng );
+	}
+
+	return true;
+}
+
+/* Make 'dst' a copy of 'src', down to the random state. 'dst' must not be set
+   up already. This takes constant time: the two share the arena's tiles and
+   the Snek's segments until one of them writes, which is what makes it cheap
+   enough to keep a snapshot every tick. Either can then be stepped or freed
+   without touching the other. */
+bool gameCopy( Game * dst, Game * src ) {
+	*dst = *src;
+	if( !arenaCopy( &dst->arena, &src->arena ) ) {
+		errLog( "gameCopy(): arenaCopy() failed." );
+		return false;
+	}
+	if( !snakeCopy( &dst->snake, &src->snake ) ) {
+		errLog( "gameCopy(): snakeCopy() failed." );
+		arenaFree( &dst->arena );
+		return false;
+	}
+	return true;
+}
+
+/* A 64-bit digest of the game state (FNV-1a, a value at a time): the Snek,
+   its heading and length, the score, the tick, the random state, and the
+   arena's cells through arenaDigest(). Games that differ almost always hash
+   differently, so a mismatch between two runs pins down the first tick where
+   they part, but equal hashes are strong evidence, not proof. The arena
+   part costs one step per tile. */
+uint64_t gameHash( Game * game ) {
+	uint64_t h = 0xCBF29CE484222325ULL;
+	#define GAME_HASH_MIX( v ) ( h = ( h ^ (uint64_t)(v) ) * 0x100000001B3ULL )
+
+	GAME_HASH_MIX( game->tick );
+	GAME_HASH_MIX( game->over );
+	GAME_HASH_MIX( game->px );
+	GAME_HASH_MIX( game->py );
+	GAME_HASH_MIX( game->pdir );
+	GAME_HASH_MIX( game->plen );
+	GAME_HASH_MIX( game->n_apples );
+	GAME_HASH_MIX( game->arena.n_free );
+	GAME_HASH_MIX( arenaDigest( &game->arena ) );
+	int i;
+	for( i = 0; i < 4; i++ ) {
+		GAME_HASH_MIX( game->rng.s[i] );
+	}
+	for( i = 0; i < game->snake.len; i++ ) {
+		Coord seg = snakeGetSegment( &game->snake, i );
+		GAME_HASH_MIX( seg.x );
+		GAME_HASH_MIX( seg.y );
+	}
+
+	#undef GAME_HASH_MIX
+	return h;
+}
+
+void gameFree( Game * game ) {
+	arenaFree( &game->arena );
+	snakeFree( &game->snake );
+}
+
+// Whether 'dir' would change the Snek's heading. Going straight on is not a turn,
+// and turning 180 degrees (north to south, east to west) is not allowed.
+bool gameCanTurn( Game * game, int dir ) {
+	switch( dir ) {
+	case DIR_WEST:
+		return game->pdir != DIR_EAST && game->pdir != DIR_WEST;
+	case DIR_EAST:
+		return game->pdir != DIR_WEST && game->pdir != DIR_EAST;
+	case DIR_NORTH:
+		return game->pdir != DIR_SOUTH && game->pdir != DIR_NORTH;
+	case DIR_SOUTH:
+		return game->pdir != DIR_NORTH && game->pdir != DIR_SOUTH;
+	default:
+		return false;
+	}
+}
+
+int gameStep( Game * game, int input_dir ) {
+	if( game->over ) {
+		return STEP_GAME_OVER;
+	}
+
+	if( gameCanTurn( game, input_dir ) ) {
+		game->pdir = input_dir;
+	}
+
+	int result = STEP_MOVED;
+
+	// Game Over Condition. Empty cells, the usual case, are told apart by their occupancy bit alone.
+	int under = arenaIsOccupied( &game->arena, game->px, game->py ) ? getCell( &game->arena, game->px, game->py ) : CELL_EMPTY;
+
+	if( under == CELL_WALL || under >= CELL_SNAKE ) {
+		game->over = true;
+		return STEP_GAME_OVER;
+	}
+
+	// Snek meets apple
+	if( under == CELL_APPLE ) {
+		game->plen++;
+		game->n_apples++;
+		if( putCellRandom( &game->arena, CELL_APPLE, &game->rng ) != 0 ) {
+			errLog( "gameStep(): No empty cells left to place an apple." );
+		}
+		result = STEP_ATE;
+	}
+
+	// Clip Snek tail, but only if it hasn't just eaten an apple.
+	// The body trails the head by plen + 1 cells.
+	else if( game->snake.len > game->plen ) {
+		Coord vacated = snakePopTail( &game->snake );
+		putCell( &game->arena, CELL_EMPTY, vacated.x, vacated.y );
+	}
+
+	// Write Snek body to buffer.  Overwrites apples
+	if( game->plen > 0 ) {
+		if( !snakePushHead( &game->snake, game->px, game->py ) ) {
+			errQuit( "FATAL: gameStep(): snakePushHead() failed." );
+		}
+		putCell( &game->arena, CELL_SNAKE + (game->snake.pushed % 2), game->px, game->py );
+	}
+
+	// Move Snek head
+	if( game->pdir == DIR_EAST ) {
+		game->px++;
+	}
+	if( game->pdir == DIR_WEST ) {
+		game->px--;
+	}
+	if( game->pdir == DIR_SOUTH ) {
+		game->py++;
+	}
+	if( game->pdir == DIR_NORTH ) {
+		game->py--;
+	}
+
+	game->tick++;
+
+	return result;
+}
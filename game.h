@@ -0,0 +1,61 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include <stdbool.h>
+
+#include "error_handler.h"
+#include "arena.h"
+#include "snake.h"
+#include "rng.h"
+
+
+/* Headless game rules. A Game holds everything needed to advance a round of
+   Snek -- the arena, the Snek, the score and its own random state -- and
+   gameStep() moves it forward by one tick. Nothing in here touches Curses or
+   the clock, so the same seed and the same inputs always produce the same
+   game, and it can run as fast as the CPU allows. */
+
+#define SNEK_VERSION "v1.02"
+
+// Direction constants. Also used as the input to gameStep().
+#define DIR_NONE  0
+#define DIR_EAST  1
+#define DIR_WEST  2
+#define DIR_NORTH 3
+#define DIR_SOUTH 4
+
+// gameStep() results
+#define STEP_MOVED 0
+#define STEP_ATE 1
+#define STEP_GAME_OVER 2
+
+#define GAME_START_LENGTH 5
+
+// Bigger arenas get more apples, one for every so many cells (the original
+// 23x23 arena has exactly one), so that there is always one within reach.
+// Every apple pins down an arena tile, so there is a limit.
+#define GAME_CELLS_PER_APPLE (23 * 23)
+#define GAME_APPLES_MAX 1024
+
+typedef struct Game_t {
+	Arena arena;
+	Snake snake;
+
+	int px, py;			// Snek head. Not written to the arena until the Snek moves off it.
+	int pdir;
+	int plen;			// Snek Tail Length
+	int n_apples;		// Apples eaten
+
+	bool over;
+	unsigned long tick;
+	Rng rng;			// Apple placement is the only random event.
+} Game;
+
+bool gameInit( Game * game, int w, int h, int board_type, const Rng * rng );
+bool gameCopy( Game * dst, Game * src );
+uint64_t gameHash( Game * game );
+void gameFree( Game * game );
+bool gameCanTurn( Game * game, int dir );
+int gameStep( Game * game, int input_dir );
+
+#endif
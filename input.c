@@ -0,0 +1,74 @@
+#include "input.h"
+
+void inputInit( InputQueue * q ) {
+	inputClear( q );
+	q->n_dropped = 0;
+	q->n_latency = 0;
+	q->latency_sum_ns = 0;
+	q->latency_max_ns = 0;
+}
+
+// Forget every queued turn.
+void inputClear( InputQueue * q ) {
+	q->head = 0;
+	q->n = 0;
+	q->shown_pending = false;
+}
+
+// Queue a turn. Returns false, dropping it, if the queue is full.
+bool inputPush( InputQueue * q, int dir ) {
+	if( q->n == INPUT_QUEUE_MAX ) {
+		q->n_dropped++;
+		return false;
+	}
+
+	InputEvent * ev = &q->events[ ( q->head + q->n ) % INPUT_QUEUE_MAX ];
+	ev->dir = dir;
+	clock_gettime( CLOCK_MONOTONIC, &ev->when );
+	q->n++;
+
+	return true;
+}
+
+// The turn for this tick: the oldest queued one that the Snek can make, or DIR_NONE.
+int inputNextTurn( InputQueue * q, Game * game ) {
+	while( q->n > 0 ) {
+		InputEvent * ev = &q->events[ q->head ];
+		q->head = ( q->head + 1 ) % INPUT_QUEUE_MAX;
+		q->n--;
+
+		if( gameCanTurn( game, ev->dir ) ) {
+			q->shown_pending = true;
+			q->pending_when = ev->when;
+			return ev->dir;
+		}
+	}
+	return DIR_NONE;
+}
+
+// Call once a frame is on screen.
+void inputFrameShown( InputQueue * q ) {
+	if( !q->shown_pending ) {
+		return;
+	}
+
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	long long ns = ( now.tv_sec - q->pending_when.tv_sec ) * 1000000000LL
+		+ ( now.tv_nsec - q->pending_when.tv_nsec );
+
+	q->n_latency++;
+	q->latency_sum_ns += ns;
+	if( ns > q->latency_max_ns ) {
+		q->latency_max_ns = ns;
+	}
+	q->shown_pending = false;
+}
+
+void inputLogStats( InputQueue * q ) {
+	if( q->n_latency == 0 ) {
+		return;
+	}
+	errInfo( "Turns: %ld, %ld keys dropped. Key to frame: mean %lld us, max %lld us.",
+		q->n_latency, q->n_dropped, q->latency_sum_ns / q->n_latency / 1000, q->latency_max_ns / 1000 );
+}
@@ -0,0 +1,51 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdbool.h>
+#include <time.h>
+
+#include "error_handler.h"
+#include "game.h"
+
+
+/* Queue of turns typed by the player, waiting for ticks to use them. The
+   main loop pushes every arrow key as soon as it is read; each tick then
+   takes the oldest turn that is still valid for the direction the Snek is
+   heading, so a quick "up, left" within one tick becomes two turns on two
+   ticks instead of the first one being lost. Turns that would do nothing
+   (the current direction) or are not allowed (straight back) are skipped.
+   When the queue is full, further keys are dropped.
+
+   Each turn remembers when its key was read. After the frame that shows
+   it, inputFrameShown() records the key-to-frame latency. */
+
+#define INPUT_QUEUE_MAX 8
+
+typedef struct InputEvent_t {
+	int dir;
+	struct timespec when;
+} InputEvent;
+
+typedef struct InputQueue_t {
+	InputEvent events[INPUT_QUEUE_MAX];
+	int head;				// Oldest event.
+	int n;
+	long n_dropped;
+
+	// The turn taken most recently, waiting for its frame to be shown.
+	bool shown_pending;
+	struct timespec pending_when;
+
+	long n_latency;
+	long long latency_sum_ns;
+	long long latency_max_ns;
+} InputQueue;
+
+void inputInit( InputQueue * q );
+void inputClear( InputQueue * q );
+bool inputPush( InputQueue * q, int dir );
+int inputNextTurn( InputQueue * q, Game * game );
+void inputFrameShown( InputQueue * q );
+void inputLogStats( InputQueue * q );
+
+#endif
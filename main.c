@@ -1,5 +1,4 @@
 /* Snek */
-#define SNEK_VERSION "v1.02"
 
 // C Standard Library
 #include <stdio.h>
@@ -9,6 +8,12 @@
 #include <math.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+
+// POSIX
+#include <poll.h>
+#include <unistd.h>
 
 // Curses
 #include "curses.h"
@@ -23,133 +28,232 @@
 #include "draw.h"           // Some additional Curses helper functions.
 
 #include "board.h"			// Load and display boards from an ascii art editor
+#include "game.h"			// Game rules, independent of Curses
+#include "render.h"			// Draws the arena, redrawing only what changed
+#include "ticker.h"			// Fixed-rate tick timer for the main loop
+#include "input.h"			// Queue of turns waiting for a tick
+#include "autopilot.h"		// Computer player, for --auto
+#include "replay.h"			// Record games, and play them back headless
+#include "profile.h"			// Per-phase frame timing
+
+#define TICK_MS_DEFAULT 200		// Snek speed: one move per tick.
+#define TICK_CATCH_UP_MAX 4		// Most ticks run back to back after a stall; the rest are skipped.
+#define OVERLAY_MS 1000			// How often the timing overlay is brought up to date.
+
+static void printUsage( void ) {
+	printf( "Usage: snek [--size W H] [--tick MS] [--seed N] [--auto] [--record FILE] [--stats FILE]\n"
+		"            [--theme NAME] [--output curses|ansi|null]\n"
+		"       snek --replay FILE [TICK...]\n"
+		"       snek --convert IN OUT [text|binary]\n"
+		"       snek --version\n" );
+}
 
-/* Cell IDs */
-#define CELL_EMPTY 0
-#define CELL_WALL 1
-#define CELL_APPLE 2
-#define CELL_SNAKE 100 // 100 + length count
-#define CELL_SNAKE_TO_EMPTY (CELL_SNAKE-1)
+static double nowMs( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
 
-/* Bounds checking */
-int inBounds( int x, int y ) {
-	if( x >= 0 && x <= VIEWPORT_W - 1 && y >= 0 && y <= VIEWPORT_H - 1 ) {
+/* Play a recording back headless: snek --replay FILE [TICK...]. Prints the
+   state at each tick given, in that order (any order works: going back
+   restores a snapshot), or at the end of the recording if none are. */
+static int playReplay( char * filename, int n_ticks, char ** ticks ) {
+	Replay replay;
+	if( !replayLoad( &replay, filename ) ) {
+		fprintf( stderr, "\nCould not load the replay %s.\n", filename );
 		return 1;
 	}
-	else {
-		return 0;
+	ReplayPlayer player;
+	if( !replayPlayerInit( &player, &replay ) ) {
+		replayFree( &replay );
+		return 1;
 	}
-}
 
-int getCell( int * brd, int x, int y ) {
-	int kind;
-	if( inBounds( x, y ) ) {
-		kind = brd[ x * VIEWPORT_H + y ];
+	int i;
+	for( i = 0; i < n_ticks || i == 0; i++ ) {
+		unsigned long tick = n_ticks ? strtoul( ticks[i], NULL, 10 ) : replay.hdr.n_ticks;
+		double start = nowMs();
+		if( !replaySeek( &player, tick ) ) {
+			break;
+		}
+		printf( "{\"replay\":\"%s\",\"tick\":%lu,\"apples\":%d,\"over\":%s,\"hash\":\"%016llx\",\"ms\":%.3f}\n",
+			filename, player.game.tick, player.game.n_apples, player.game.over ? "true" : "false",
+			(unsigned long long)gameHash( &player.game ), nowMs() - start );
 	}
-	else {
-		kind = -1;
+
+	replayPlayerFree( &player );
+	replayFree( &replay );
+	return i < n_ticks ? 1 : 0;
+}
+
+/* The timing overlay: frame times over the last OVERLAY_MS, and the phases
+   that take the most of them. 'since' is the profile as it was at the last
+   update, and is brought up to date. */
+static void drawOverlay( Renderer * r, Profile * since ) {
+	static const int phases[] = { PROF_FRAME, PROF_STEP, PROF_DRAW, PROF_REFRESH };
+	attr_t attr = colorAttr( COLOR_WHITE, COLOR_BLACK, 1, 0 );
+	renderText( r, 8, 42, attr, "%-8s %9s %9s", "us", "p50", "p99" );
+	int i;
+	for( i = 0; i < (int)( sizeof(phases) / sizeof(phases[0]) ); i++ ) {
+		ProfileHist * h = &profile.hist[ phases[i] ];
+		ProfileHist * before = &since->hist[ phases[i] ];
+		renderText( r, 9 + i, 42, attr, "%-8s %9.1f %9.1f", profilePhaseName( phases[i] ),
+			profilePercentile( h, before, 0.5 ) / 1e3, profilePercentile( h, before, 0.99 ) / 1e3 );
 	}
-	return kind;	
+	*since = profile;
 }
 
-void putCell( int * brd, int kind, int x, int y ) {
-	if( inBounds( x, y ) ) {
-		brd[x * VIEWPORT_H + y] = kind;
+static void clearOverlay( Renderer * r ) {
+	int i;
+	for( i = 0; i < 5; i++ ) {
+		renderText( r, 8 + i, 42, A_NORMAL, "%28s", "" );
 	}
-	return;
 }
 
-int putCellRandom( int *brd, int kind, int under ) {
-	int x, y;
-	int r;
-	int space = 0;
-	
-	/* Determine if there is space to put something */
-	for( x = 0; x < VIEWPORT_W; x++ ) {
-		for( y = 0; y < VIEWPORT_H; y++ ) {
-			if( getCell(brd, x, y) == under ) {
-				space++;
+int main( int argc, char *argv[] ) {
+
+	int arena_w = 23;
+	int arena_h = 23;
+	int tick_ms = TICK_MS_DEFAULT;
+	uint64_t seed = 0;
+	bool seed_given = false;
+	bool auto_play = false;
+	char * record_file = NULL;
+	char * stats_file = PROFILE_FILE_DEFAULT;
+	Theme * theme = NULL;
+	int output = RENDER_BACKEND_CURSES;
+
+	int arg;
+	for( arg = 1; arg < argc; arg++ ) {
+		// Print version
+		if( strcmp( argv[arg], "--version" ) == 0 ) {
+			printf( "Snek " SNEK_VERSION "\n");
+			exit(1);
+		}
+
+		// Convert a board file: snek --convert IN OUT [text|binary]. Binary is the default.
+		else if( strcmp( argv[arg], "--convert" ) == 0 && arg + 2 < argc ) {
+			errorHandlerInit( &error_handler, 1 );
+
+			char * in = argv[arg + 1];
+			char * out = argv[arg + 2];
+			int format = BOARD_FORMAT_BINARY;
+			if( arg + 3 < argc && strcmp( argv[arg + 3], "text" ) == 0 ) {
+				format = BOARD_FORMAT_TEXT;
+			}
+
+			Board * brd = boardLoadFromFile( in );
+			if( !brd || !boardSaveToFile( brd, out, format ) ) {
+				fprintf( stderr, "\nCould not convert %s to %s.\n", in, out );
+				boardFree( brd );
+				return 1;
 			}
+			boardFree( brd );
+			return 0;
 		}
-	}
 
-	r = rand() % space;
-	
-	if( space > 0 ) {
-		for( x = 0; x < VIEWPORT_W; x++ ) {
-			for( y = 0; y < VIEWPORT_H; y++ ) {
-				if( getCell(brd, x, y) == under ) {
-					if( r == 0 ) {
-						putCell(brd, kind, x, y);
-						return 0;
-					}
-					else {
-						r--;
-					}
-				}
+		// Arena size: --size W H. The viewport scrolls over arenas bigger than the screen.
+		else if( strcmp( argv[arg], "--size" ) == 0 && arg + 2 < argc ) {
+			arena_w = atoi( argv[arg + 1] );
+			arena_h = atoi( argv[arg + 2] );
+			if( arena_w < 3 || arena_h < 3 ) {
+				fprintf( stderr, "Arena size must be at least 3x3.\n" );
+				return 1;
 			}
+			arg += 2;
 		}
-	}
-	return 1;
-}
 
+		// Game speed: --tick MS between moves.
+		else if( strcmp( argv[arg], "--tick" ) == 0 && arg + 1 < argc ) {
+			tick_ms = atoi( argv[arg + 1] );
+			if( tick_ms < 1 ) {
+				fprintf( stderr, "The tick must be at least 1 ms.\n" );
+				return 1;
+			}
+			arg += 1;
+		}
 
-#define BOARDTYPE_EMPTY 0
-#define BOARDTYPE_CROSS 1
+		// Play a particular game again: --seed N.
+		else if( strcmp( argv[arg], "--seed" ) == 0 && arg + 1 < argc ) {
+			seed = strtoull( argv[arg + 1], NULL, 10 );
+			seed_given = true;
+			arg += 1;
+		}
 
-void boardMake( int * brd, int b_n, int b_s, int b_e, int b_w, int board_type ) {
-	int x, y;
-	for( x = 0; x < VIEWPORT_W; x++ ) {
-		for( y = 0; y < VIEWPORT_H; y++ ) {
+		// Play a recording back headless: --replay FILE [TICK...]. Takes the rest of the line.
+		else if( strcmp( argv[arg], "--replay" ) == 0 && arg + 1 < argc ) {
+			errorHandlerInit( &error_handler, 1 );
+			int result = playReplay( argv[arg + 1], argc - arg - 2, argv + arg + 2 );
+			errorHandlerShutdown( &error_handler );
+			return result;
+		}
 
-			// Start with an empty cell
-			putCell( brd, CELL_EMPTY, x, y );
-		
-			// Plot borders if requested
-			if(	(b_n && y == 0 )
-			  ||	(b_s && y == VIEWPORT_H - 1)
-			  ||	(b_e && x == VIEWPORT_W - 1)
-			  ||  	(b_w && x == 0) ) {
-				putCell( brd, CELL_WALL, x, y );
+		// Record the game to a file: --record FILE.
+		else if( strcmp( argv[arg], "--record" ) == 0 && arg + 1 < argc ) {
+			record_file = argv[arg + 1];
+			arg += 1;
+		}
+
+		// Where the frame timings go at the end: --stats FILE.
+		else if( strcmp( argv[arg], "--stats" ) == 0 && arg + 1 < argc ) {
+			stats_file = argv[arg + 1];
+			arg += 1;
+		}
+
+		// How the arena looks: --theme NAME.
+		else if( strcmp( argv[arg], "--theme" ) == 0 && arg + 1 < argc ) {
+			theme = renderFindTheme( argv[arg + 1] );
+			if( !theme ) {
+				fprintf( stderr, "There is no theme called %s. The themes are: ", argv[arg + 1] );
+				renderListThemes( stderr );
+				return 1;
 			}
-		
-			// Cross pattern
-			if( board_type == BOARDTYPE_CROSS ) {
-				if( (x > 3 && x < VIEWPORT_W - 4 && y > VIEWPORT_H/ 2 - 2 && y < VIEWPORT_H/2 + 2) 
-				||  (y > 3 && y < VIEWPORT_H - 4 && x > VIEWPORT_W/ 2 - 2 && x < VIEWPORT_W/2 + 2) ) {
-					putCell( brd, CELL_WALL, x, y );
-				}
+			arg += 1;
+		}
+
+		// Where the frames go: --output curses|ansi|null. With ansi, each frame is one write() of raw escape codes.
+		else if( strcmp( argv[arg], "--output" ) == 0 && arg + 1 < argc ) {
+			output = renderFindBackend( argv[arg + 1] );
+			if( output < 0 ) {
+				fprintf( stderr, "The output must be curses, ansi or null.\n" );
+				return 1;
 			}
+			arg += 1;
 		}
-	}
-}
 
-int main( int argc, char *argv[] ) {
+		// Let the autopilot play.
+		else if( strcmp( argv[arg], "--auto" ) == 0 ) {
+			auto_play = true;
+		}
 
-	// Print version
-	if( argc > 1 && strncmp( argv[1], "--version", 10 ) == 0 ) {
-		printf( "Snek " SNEK_VERSION "\n");
-		exit(1);
+		else {
+			printUsage();
+			return 1;
+		}
 	}
 
     /*  -- System Init.  */
 
-    VIEWPORT_W = 23;
-    VIEWPORT_H = 23;
+    VIEWPORT_W = arena_w < VIEWPORT_MAX_W ? arena_w : VIEWPORT_MAX_W;
+    VIEWPORT_H = arena_h < VIEWPORT_MAX_H ? arena_h : VIEWPORT_MAX_H;
     VIEWPORT_X = 0;
     VIEWPORT_Y = 0;
 
-    // Debug logging
+    // Debug logging. File writes happen on a background thread so they never hold up a tick.
     errorHandlerInit( &error_handler, 0 );
-    errLog( "    ** Logging new session **");
-
-    // Seed randomizer.  Call only once.  Consider getting a more robust randomizer in the future.
-	// This randomizes based on the current second -- it's easy to start multiple instances 
-	// with the same seed randomizer.
-    srand(time(NULL));
+    errorHandlerStartAsync( &error_handler );
+    errInfo( "    ** Logging new session **");
+
+    // Game seed. Unless one was given with --seed, mix the clock down to the nanosecond with
+	// the process ID, so that instances started together still get different games.
+	if( !seed_given ) {
+		struct timespec now;
+		clock_gettime( CLOCK_REALTIME, &now );
+		seed = ( (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec ) ^ ( (uint64_t)getpid() << 40 );
+	}
 
-    // Set a fixed seed for debugging purposes.
-    //srand(4);
+    // The seed is logged, so any game can be played again with --seed.
+    errInfo( "Game seed: %llu", (unsigned long long)seed );
 
     // Curses startup wrapper.
     if( init_curses() != 0) {
@@ -197,212 +301,238 @@ int main( int argc, char *argv[] ) {
 	/* Main loop. */
     // Loop control vars
     bool keep_going = true;
-    bool first_tick = true;
-
+    bool paused = false;
 
-	// Some vars for Snek.
 	int player_input = 0;		// Player keyboard input
-	int px, py;
-	if( board_select == BOARDTYPE_EMPTY ) {
-		px = VIEWPORT_W / 2;	// Player XY.  May need to be overridden depending on the board.
-		py = VIEWPORT_H / 2;
+	int move;
+
+	// Turns typed ahead of the ticks that will make them.
+	InputQueue input;
+	inputInit( &input );
+
+	// With --auto, the autopilot steers instead, and the arrow keys do nothing.
+	Autopilot autopilot;
+	if( auto_play && !autopilotInit( &autopilot ) ) {
+		errQuit( "FATAL: main.c: autopilotInit() failed." );
+	}
+
+	// Game init
+	Game game;
+	Rng rng;
+	rngSeed( &rng, seed );
+	if( !gameInit( &game, arena_w, arena_h, board_select, &rng ) ) {
+		errQuit( "FATAL: main.c: gameInit() failed." );
+	}
+
+	Replay replay;
+	if( record_file && !replayInit( &replay, seed, arena_w, arena_h, board_select ) ) {
+		errQuit( "FATAL: main.c: replayInit() failed." );
+	}
+
+	/* Renderer init. Other backends take over the screen from here on, so
+	   Curses is given its last refresh now, while it still has the title
+	   screen's clear() to send; otherwise the next getch() would send it. */
+	if( output != RENDER_BACKEND_CURSES ) {
+		refresh();
+	}
+	Coord arena_offset = { VIEWPORT_X, VIEWPORT_Y };
+	Renderer renderer;
+	if( !renderInitBackend( &renderer, VIEWPORT_W, VIEWPORT_H, arena_offset, output, STDOUT_FILENO ) ) {
+		errQuit( "FATAL: main.c: renderInit() failed." );
 	}
-	if( board_select == BOARDTYPE_CROSS ) {
-		px = 1;
-		py = 1;
+	attr_t ui_attr = colorAttr( COLOR_WHITE, COLOR_BLACK, 1, 0 );
+	if( theme ) {
+		renderSetTheme( &renderer, theme );
 	}
-	
-	int plen = 5;				// Snek Tail Length
-	int n_apples = 0;			// Apples eaten
-
-	// Direction constants
-	#define DIR_EAST  1
-	#define DIR_WEST  2
-	#define DIR_NORTH 3
-	#define DIR_SOUTH 4
-	int pdir = DIR_EAST;
-
-	// Board init
-	int * board;
-	board = malloc( sizeof(int) * (VIEWPORT_W * VIEWPORT_H) );
-	if( !board ) {
-		errQuit( "FATAL: main.c: malloc() failed on board * pointer." );
+	int shown_apples = -1;
+
+	// Frame timing, with the overlay toggled by 't'.
+	static Profile overlay_since;
+	bool show_overlay = false;
+	double overlay_due = 0;
+	if( SNEK_PROFILE ) {
+		profileStart( &profile );
 	}
-	
-	boardMake( board, 1, 1, 1, 1, board_select );
-	putCellRandom( board, CELL_APPLE, CELL_EMPTY );
+
+	/* Tick timing. The loop sleeps in poll() until either a key arrives or the
+	   ticker says a tick is due, so keys no longer cut a tick short, and a
+	   paused or finished game costs no CPU. */
+	Ticker ticker;
+	if( !tickerInit( &ticker, tick_ms ) || !tickerStart( &ticker ) ) {
+		errQuit( "FATAL: main.c: could not start the tick timer." );
+	}
+	nodelay( stdscr, TRUE );
+
+	struct pollfd wait_on[2];
+	wait_on[0].fd = STDIN_FILENO;
+	wait_on[0].events = POLLIN;
+	wait_on[1].fd = ticker.fd;
+	wait_on[1].events = POLLIN;
+
+	// Show the arena before the first move.
+	renderArena( &renderer, &game );
+	renderFlush( &renderer );
 
 	// Main loop
     while(keep_going) {
-        // Makes Curses "time out" if no key has been pressed in N tenths of a second.
-        halfdelay(2);
-
-        // Do some things differently on the very first tick.
-        if(!first_tick) {
-	        // -- Input processing
-			player_input = getch();
+		// A signal (such as a terminal resize) can cut the wait short; Curses then has a key for us.
+		if( poll( wait_on, 2, -1 ) < 0 && errno != EINTR ) {
+			errQuit( "FATAL: main.c: poll() failed." );
+		}
+		profBegin( frame_start );
 
-			// Note: disallow player from turning 180 degrees (north to south, east to west)
+        // -- Input processing. Take every key that is waiting.
+		profBegin( input_start );
+		while( ( player_input = getch() ) != ERR ) {
+			move = DIR_NONE;
 			switch (player_input) {
-
 			case KEY_LEFT:
-				if( pdir != DIR_EAST ) {
-					pdir = DIR_WEST;
-					}
+				move = DIR_WEST;
 				break;
 			case KEY_RIGHT:
-				if( pdir != DIR_WEST ) {
-					pdir = DIR_EAST;
-				}
+				move = DIR_EAST;
 				break;
 			case KEY_UP:
-				if( pdir != DIR_SOUTH ) {
-					pdir = DIR_NORTH;
-				}
+				move = DIR_NORTH;
 				break;
 			case KEY_DOWN:
-				if( pdir != DIR_NORTH ) {
-					pdir = DIR_SOUTH;
+				move = DIR_SOUTH;
+				break;
+			// Repaint everything after a resize, or on Ctrl+L if the display gets garbled.
+			case KEY_RESIZE:
+			case 12:
+				renderClear( &renderer );
+				renderArena( &renderer, &game );
+				shown_apples = -1;
+				overlay_due = 0;
+				break;
+			// Pause. The ticker stops, so nothing runs until the next key.
+			case 'p':
+				if( game.over ) {
+					break;
+				}
+				paused = !paused;
+				if( paused ) {
+					tickerStop( &ticker );
+					renderText( &renderer, 6, 42, ui_attr, "Paused ('p' to resume)" );
+				}
+				else {
+					tickerStart( &ticker );
+					renderText( &renderer, 6, 42, ui_attr, "                      " );
 				}
 				break;
+			// Frame timing overlay
+			case 't':
+				if( SNEK_PROFILE ) {
+					show_overlay = !show_overlay;
+					overlay_due = 0;
+					if( !show_overlay ) {
+						clearOverlay( &renderer );
+					}
+				}
+				break;
+			// Quitting
+			case 'q':
+				keep_going = false;
+				break;
 			default:
 				break;
 			}
-		}
 
-        // Quitting
-        if( player_input == 'q' ) {
-            keep_going = false;
-			continue;
-        }
-
-		// Game logic
-		
-		// Game Over Condition
-		int under = getCell( board, px, py );
-
-		if( under == CELL_WALL || under >= CELL_SNAKE ) {
-			colorSet( COLOR_WHITE, COLOR_RED, 1, 1 );
-			mvprintw(0, 0, " * S N E K   O V E R * " );
-			colorSet( COLOR_WHITE, COLOR_BLACK, 1, 0 );
-			mvprintw(3, 0, "'q' to quit" );
-			halfdelay(0);
-			continue;
-		}
-
-		// Snek meets apple
-		if( under == CELL_APPLE ) {
-			plen++;
-			n_apples++;
-			putCellRandom( board, CELL_APPLE, CELL_EMPTY );
-		}
-		
-		// Clip Snek tail, but only if it hasn't just eaten an apple.
-		else {
-			int x, y;
-			for( x = 0; x < VIEWPORT_W; x++ ) {
-				for( y = 0; y < VIEWPORT_H; y++ ) {
-					int this = getCell( board, x, y );
-					if( this >= CELL_SNAKE ) {
-						putCell( board, this - 1, x, y );
-					}
-					if( this == CELL_SNAKE_TO_EMPTY) {
-						putCell( board, CELL_EMPTY, x, y );
-					}
-				}
+			if( move != DIR_NONE && !paused && !game.over && !auto_play ) {
+				inputPush( &input, move );
 			}
 		}
+		profEnd( PROF_INPUT, input_start );
 
-		// Write Snek body to buffer.  Overwrites apples
-		if( plen > 0 ) {
-			putCell( board, CELL_SNAKE + plen, px, py );
-		}
-
-		// Move Snek head
-		if( pdir == DIR_EAST ) {
-			px++;
-		}
-		if( pdir == DIR_WEST ) {
-			px--;
+		// -- Game logic, once for every tick that has come due.
+		int ticks = tickerRead( &ticker );
+		if( ticks > TICK_CATCH_UP_MAX ) {
+			ticks = TICK_CATCH_UP_MAX;
 		}
-		if( pdir == DIR_SOUTH ) {
-			py++;
-		}
-		if( pdir == DIR_NORTH ) {
-			py--;
-		}
-		/*  Clear will wipe the Curses window, but it can cause noticeable tearing artifacts 
-		    in the Windows 10 console.  It may look OK on other platforms or terminals, though.
-            TODO: Drop in a config option to use clear() every on every loop tick if desired.
-			Update: Now I'm experiencing artifacts when clear() is not used. Leaving it on for now.	*/
-        clear();
-
-
-		/* Draw background */
-
-		{
-		int x, y;
-		for( x = 0; x < VIEWPORT_W; x++ ) {
-			for( y = 0; y < VIEWPORT_H; y++ ) {
-				int this = getCell( board, x, y );
-				int glyph = 'X';
-				// Cell is...
-				// a) Wall
-				if( this == CELL_WALL ) {
-					colorSet( COLOR_BLUE, COLOR_BLACK, 1, 0 );
-					glyph = '#';
-				}
-
-				// b) Apple
-				else if( this == CELL_APPLE ) {
-					colorSet( COLOR_RED, COLOR_BLACK, 1, 0 );
-					glyph = '@';
-				}
+		while( keep_going && ticks-- > 0 ) {
+			profBegin( turn_start );
+			int turn = auto_play ? autopilotNextTurn( &autopilot, &game ) : inputNextTurn( &input, &game );
+			if( record_file && !replayRecord( &replay, &game, turn ) ) {
+				errLog( "main.c: the recording stopped at tick %lu.", game.tick );
+				replayEnd( &replay, &game );
+				replaySave( &replay, record_file );
+				replayFree( &replay );
+				record_file = NULL;
+			}
+			profEnd( PROF_TURN, turn_start );
 
-				// c) Snek body
-				else if( this >= CELL_SNAKE ) {
-					colorSet( COLOR_GREEN, COLOR_BLACK, 0, 0 );
-					if( this % 2 == 1 ) { 
-						glyph = 'S';
-					}
-					else if( this % 2 == 0 ) {
-						glyph = 's';
-					}
-				}
+			profBegin( step_start );
+			int result = gameStep( &game, turn );
+			profEndAlso( PROF_STEP, result == STEP_ATE ? PROF_EAT : result == STEP_MOVED ? PROF_MOVE : -1, step_start );
+			if( result == STEP_GAME_OVER ) {
+				renderText( &renderer, 0, 0, colorAttr( COLOR_WHITE, COLOR_RED, 1, 1 ), " * S N E K   O V E R * " );
+				renderText( &renderer, 3, 0, ui_attr, "'q' to quit" );
 
-				// d) empty
-				else {
-					colorSet( COLOR_BLUE, COLOR_BLACK, 0, 0 );
-					glyph = ' ';
-				}
-				mvaddch(y, x, glyph);
+				// Nothing more to do until 'q' is pressed.
+				tickerStop( &ticker );
+				break;
 			}
 		}
-		}
-		/* Draw the Snek head */
 
-		colorSet( COLOR_GREEN, COLOR_BLACK, 1, 0 );
-		mvaddch( py, px, 'S' );
+		if( !game.over ) {
+			/* Draw the arena. Only cells that changed since the last frame are sent to the terminal.
+			   Clearing the whole window every tick causes noticeable tearing in the Windows 10
+			   console, so clear() is only used when the screen needs a full repaint. */
+			profBegin( draw_start );
+			renderArena( &renderer, &game );
+			profEnd( PROF_DRAW, draw_start );
+		}
 
 		/* Draw UI elements */
-		colorSet( COLOR_WHITE, COLOR_BLACK, 1, 0 );
-		mvprintw( 4, 42, "                    " );
-		mvprintw( 4, 42, "Apples: %d", n_apples );
-
-        // Curses display update.
-        refresh();
+		profBegin( ui_start );
+		if( game.n_apples != shown_apples ) {
+			renderText( &renderer, 4, 42, ui_attr, "Apples: %-12d", game.n_apples );
+			shown_apples = game.n_apples;
+		}
+		if( show_overlay && nowMs() >= overlay_due ) {
+			drawOverlay( &renderer, &overlay_since );
+			overlay_due = nowMs() + OVERLAY_MS;
+		}
+		profEnd( PROF_UI, ui_start );
 
-        first_tick = 0;
+        // Display update: refresh() for Curses, one write() for ANSI.
+		profBegin( refresh_start );
+		renderFlush( &renderer );
+		profEnd( PROF_REFRESH, refresh_start );
+		inputFrameShown( &input );
+		profEnd( PROF_FRAME, frame_start );
 
 		// -- End of main loop.
     }
 
+	tickerLogStats( &ticker );
+	renderLogStats( &renderer );
+	if( SNEK_PROFILE ) {
+		profileLogStats( &profile );
+		profileSave( &profile, stats_file );
+	}
+	inputLogStats( &input );
+	tickerFree( &ticker );
+	if( record_file ) {
+		replayEnd( &replay, &game );
+		if( replaySave( &replay, record_file ) ) {
+			errInfo( "Recorded %lu ticks, %u turns, to %s. State hash at the end: %016llx",
+				game.tick, replay.hdr.n_turns, record_file, (unsigned long long)gameHash( &game ) );
+		}
+		replayFree( &replay );
+	}
+	if( auto_play ) {
+		autopilotLogStats( &autopilot );
+		autopilotFree( &autopilot );
+	}
 
     /* -- Shutting down */
 
     /* Deallocate pointers */
 
-	free( board );
+	gameFree( &game );
+	renderFree( &renderer );
 
     /* Close error handler */
     errLog("    **  Shutting down.  **\n");
@@ -0,0 +1,106 @@
+#include "profile.h"
+
+Profile profile;
+
+static const char * profile_phase_names[PROF_N_PHASES] = {
+	"frame", "input", "turn", "step", "move", "eat", "draw", "ui", "refresh"
+};
+
+// Clear every histogram and start timing.
+void profileStart( Profile * p ) {
+	memset( p->hist, 0, sizeof(p->hist) );
+	p->enabled = true;
+}
+
+const char * profilePhaseName( int phase ) {
+	return phase >= 0 && phase < PROF_N_PHASES ? profile_phase_names[phase] : "?";
+}
+
+// The largest value that goes in a bucket.
+uint64_t profileBucketTop( int bucket ) {
+	if( bucket < PROFILE_SUB_COUNT ) {
+		return (uint64_t)bucket;
+	}
+	int shift = bucket / PROFILE_SUB_COUNT - 1;
+	uint64_t low = (uint64_t)( PROFILE_SUB_COUNT + bucket % PROFILE_SUB_COUNT ) << shift;
+	return low + ( ( 1ULL << shift ) - 1 );
+}
+
+/* The value that fraction q (0 to 1) of the recorded values are at or
+   below, to within its bucket. With 'since' set, only counts what was
+   recorded after that copy of the histogram was taken. */
+uint64_t profilePercentile( ProfileHist * h, ProfileHist * since, double q ) {
+	uint64_t count = h->count - ( since ? since->count : 0 );
+	if( count == 0 ) {
+		return 0;
+	}
+	uint64_t rank = (uint64_t)( q * (double)count + 0.5 );
+	if( rank < 1 ) {
+		rank = 1;
+	}
+
+	uint64_t seen = 0;
+	int b;
+	for( b = 0; b < PROFILE_BUCKETS; b++ ) {
+		seen += h->buckets[b] - ( since ? since->buckets[b] : 0 );
+		if( seen >= rank ) {
+			uint64_t top = profileBucketTop( b );
+			return top < h->max_ns ? top : h->max_ns;
+		}
+	}
+	return h->max_ns;
+}
+
+/* One JSON object per phase and line, like the benchmarks and the batch
+   simulator. "buckets" holds [largest value, count] for every bucket in
+   use, so other percentiles can be worked out later. */
+bool profileSave( Profile * p, char * filename ) {
+	FILE * f = fopen( filename, "w" );
+	if( !f ) {
+		errLog( "profileSave(): Could not open %s for writing", filename );
+		return false;
+	}
+
+	int i, b;
+	for( i = 0; i < PROF_N_PHASES; i++ ) {
+		ProfileHist * h = &p->hist[i];
+		fprintf( f, "{\"phase\":\"%s\",\"count\":%llu,\"mean_us\":%.3f,\"p50_us\":%.3f,\"p90_us\":%.3f,"
+			"\"p99_us\":%.3f,\"p999_us\":%.3f,\"max_us\":%.3f,\"buckets\":[",
+			profilePhaseName( i ), (unsigned long long)h->count,
+			h->count ? (double)h->sum_ns / h->count / 1e3 : 0.0,
+			profilePercentile( h, NULL, 0.5 ) / 1e3, profilePercentile( h, NULL, 0.9 ) / 1e3,
+			profilePercentile( h, NULL, 0.99 ) / 1e3, profilePercentile( h, NULL, 0.999 ) / 1e3,
+			h->max_ns / 1e3 );
+		bool first = true;
+		for( b = 0; b < PROFILE_BUCKETS; b++ ) {
+			if( h->buckets[b] ) {
+				fprintf( f, first ? "[%llu,%llu]" : ",[%llu,%llu]",
+					(unsigned long long)profileBucketTop( b ), (unsigned long long)h->buckets[b] );
+				first = false;
+			}
+		}
+		fprintf( f, "]}\n" );
+	}
+
+	bool ok = !ferror( f );
+	if( fclose( f ) != 0 ) {
+		ok = false;
+	}
+	if( !ok ) {
+		errLog( "profileSave(): write failed on %s", filename );
+	}
+	return ok;
+}
+
+void profileLogStats( Profile * p ) {
+	int i;
+	for( i = 0; i < PROF_N_PHASES; i++ ) {
+		ProfileHist * h = &p->hist[i];
+		if( h->count == 0 ) {
+			continue;
+		}
+		errInfo( "Phase %s: %llu times. p50 %.1f us, p99 %.1f us, max %.1f us.",
+			profilePhaseName( i ), (unsigned long long)h->count,
+			profilePercentile( h, NULL, 0.5 ) / 1e3, profilePercentile( h, NULL, 0.99 ) / 1e3, h->max_ns / 1e3 );
+	}
+}
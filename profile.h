@@ -0,0 +1,128 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "error_handler.h"
+
+
+/* Where the time in a frame goes. Each phase of the main loop is timed with
+   the monotonic clock, and every time goes into that phase's histogram.
+   profileSave() writes them all out at the end of the game; the overlay
+   shows frame times live.
+
+   The histograms are log-linear, like HdrHistogram: a value's bucket is
+   picked by its highest set bit and the PROFILE_SUB_BITS bits below it, so
+   every bucket is at most 1/32 (about 3%) as wide as the values in it,
+   whatever their size, in a fixed 15 KB per phase. Recording a value
+   is a handful of instructions and never allocates.
+
+   Timing only happens once profileStart() has been called, which main()
+   does. Anything else that runs games (the batch simulator, the benchmarks)
+   pays one untaken branch per phase. Building with -DSNEK_PROFILE=0
+   compiles the timing out altogether.
+
+   There is one Profile for the whole process and nothing guards it, so
+   only one thread may time anything. The game engine (game.c) is run from
+   other threads by the batch simulator, so it is never timed from inside;
+   main() times gameStep() as a whole, and files the time under what the
+   step did as well. */
+
+#ifndef SNEK_PROFILE
+#define SNEK_PROFILE 1
+#endif
+
+#define PROFILE_SUB_BITS 5
+#define PROFILE_SUB_COUNT ( 1 << PROFILE_SUB_BITS )
+#define PROFILE_BUCKETS ( ( 64 - PROFILE_SUB_BITS + 1 ) * PROFILE_SUB_COUNT )
+
+#define PROFILE_FILE_DEFAULT "stats.json"
+
+// Phases. Move and eat are the same times as step, split by what the step did.
+// Every phase happens inside frame.
+#define PROF_FRAME 0		// Everything done between two waits in poll().
+#define PROF_INPUT 1		// Reading and handling keys.
+#define PROF_TURN 2			// Choosing the turn for a tick, and recording it.
+#define PROF_STEP 3			// gameStep().
+#define PROF_MOVE 4			// A gameStep() that moved the Snek without eating.
+#define PROF_EAT 5			// A gameStep() that ate an apple and placed a new one.
+#define PROF_DRAW 6			// Drawing the arena.
+#define PROF_UI 7			// Drawing the score and the overlay.
+#define PROF_REFRESH 8		// Sending the frame to the terminal: refresh(), or one write().
+#define PROF_N_PHASES 9
+
+typedef struct ProfileHist_t {
+	uint64_t count;
+	uint64_t sum_ns;
+	uint64_t max_ns;
+	uint64_t buckets[PROFILE_BUCKETS];
+} ProfileHist;
+
+typedef struct Profile_t {
+	bool enabled;
+	ProfileHist hist[PROF_N_PHASES];
+} Profile;
+
+extern Profile profile;
+
+// Time one phase: profBegin( t ); ... profEnd( PROF_STEP, t );
+#if SNEK_PROFILE
+#define profBegin( mark ) uint64_t mark = profile.enabled ? profileNow() : 0
+#define profEnd( phase, mark ) \
+	do { \
+		if( profile.enabled ) { \
+			profileRecord( &profile.hist[(phase)], profileNow() - (mark) ); \
+		} \
+	} while( 0 )
+// The same, but the time also goes under 'also', unless that is negative.
+#define profEndAlso( phase, also, mark ) \
+	do { \
+		if( profile.enabled ) { \
+			uint64_t prof_ns = profileNow() - (mark); \
+			profileRecord( &profile.hist[(phase)], prof_ns ); \
+			if( (also) >= 0 ) { \
+				profileRecord( &profile.hist[(also)], prof_ns ); \
+			} \
+		} \
+	} while( 0 )
+#else
+#define profBegin( mark ) (void)0
+#define profEnd( phase, mark ) (void)0
+#define profEndAlso( phase, also, mark ) (void)0
+#endif
+
+static inline uint64_t profileNow( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline int profileBucket( uint64_t ns ) {
+	if( ns < PROFILE_SUB_COUNT ) {
+		return (int)ns;
+	}
+	int shift = 63 - __builtin_clzll( ns ) - PROFILE_SUB_BITS;
+	return ( shift + 1 ) * PROFILE_SUB_COUNT + (int)( ( ns >> shift ) - PROFILE_SUB_COUNT );
+}
+
+static inline void profileRecord( ProfileHist * h, uint64_t ns ) {
+	h->count++;
+	h->sum_ns += ns;
+	if( ns > h->max_ns ) {
+		h->max_ns = ns;
+	}
+	h->buckets[ profileBucket( ns ) ]++;
+}
+
+void profileStart( Profile * p );
+const char * profilePhaseName( int phase );
+uint64_t profileBucketTop( int bucket );
+uint64_t profilePercentile( ProfileHist * h, ProfileHist * since, double q );
+bool profileSave( Profile * p, char * filename );
+void profileLogStats( Profile * p );
+
+#endif
@@ -0,0 +1,342 @@
+#include "render.h"
+
+#if CELL_SNAKE + 1 >= RENDER_KINDS - 1 || CELL_APPLE >= CELL_SNAKE || CELL_WALL >= CELL_SNAKE
+#error "Cell kinds do not fit the glyph table."
+#endif
+
+#define renderGlyph( r, kind ) ( (r)->glyphs[ (kind) & ( RENDER_KINDS - 1 ) ] )
+
+// The first theme is the default.
+static Theme render_themes[] = {
+	{
+		"classic",
+		{ ' ', COLOR_BLUE, COLOR_BLACK, 0, 0 },
+		{ '#', COLOR_BLUE, COLOR_BLACK, 1, 0 },
+		{ '@', COLOR_RED, COLOR_BLACK, 1, 0 },
+		{ 's', COLOR_GREEN, COLOR_BLACK, 0, 0 },
+		{ 'S', COLOR_GREEN, COLOR_BLACK, 0, 0 },
+		{ 'S', COLOR_GREEN, COLOR_BLACK, 1, 0 },
+	},
+	{
+		"meadow",
+		{ '.', COLOR_GREEN, COLOR_BLACK, 0, 0 },
+		{ '#', COLOR_YELLOW, COLOR_BLACK, 0, 0 },
+		{ '@', COLOR_RED, COLOR_BLACK, 1, 0 },
+		{ 'o', COLOR_CYAN, COLOR_BLACK, 0, 0 },
+		{ 'O', COLOR_CYAN, COLOR_BLACK, 0, 0 },
+		{ '0', COLOR_CYAN, COLOR_BLACK, 1, 0 },
+	},
+	{
+		"mono",
+		{ ' ', COLOR_WHITE, COLOR_BLACK, 0, 0 },
+		{ '#', COLOR_WHITE, COLOR_BLACK, 0, 0 },
+		{ '@', COLOR_WHITE, COLOR_BLACK, 1, 0 },
+		{ 's', COLOR_WHITE, COLOR_BLACK, 0, 0 },
+		{ 'S', COLOR_WHITE, COLOR_BLACK, 0, 0 },
+		{ 'S', COLOR_WHITE, COLOR_BLACK, 1, 0 },
+	},
+};
+
+#define N_RENDER_THEMES (int)( sizeof(render_themes) / sizeof(render_themes[0]) )
+
+bool renderInit( Renderer * r, int w, int h, Coord offset ) {
+	return renderInitBackend( r, w, h, offset, RENDER_BACKEND_CURSES, -1 );
+}
+
+/* As renderInit(), with the output going to 'backend'. The ANSI backend
+   writes to 'fd'; the others leave it alone. */
+bool renderInitBackend( Renderer * r, int w, int h, Coord offset, int backend, int fd ) {
+	r->frame = malloc( sizeof(chtype) * (w * h) );
+	if( !r->frame ) {
+		errLog( "renderInit(): malloc() failed on r->frame" );
+		return false;
+	}
+	r->backend = backend;
+	if( backend == RENDER_BACKEND_ANSI && !ansiInit( &r->ansi, fd, COLS ) ) {
+		free( r->frame );
+		r->frame = NULL;
+		return false;
+	}
+	r->w = w;
+	r->h = h;
+	r->offset = offset;
+	r->camera.x = 0;
+	r->camera.y = 0;
+	r->head.x = -1;
+	r->head.y = -1;
+	r->full = true;
+	renderSetTheme( r, &render_themes[0] );
+
+	return true;
+}
+
+void renderFree( Renderer * r ) {
+	if( r->backend == RENDER_BACKEND_ANSI ) {
+		// Leave the terminal in its own colors for whatever comes next.
+		ansiResetAttr( &r->ansi );
+		ansiFlush( &r->ansi );
+		ansiFree( &r->ansi );
+	}
+	free( r->frame );
+	r->frame = NULL;
+}
+
+// RENDER_BACKEND_* for a name given on the command line, or -1.
+int renderFindBackend( char * name ) {
+	if( strcmp( name, "curses" ) == 0 ) {
+		return RENDER_BACKEND_CURSES;
+	}
+	if( strcmp( name, "ansi" ) == 0 ) {
+		return RENDER_BACKEND_ANSI;
+	}
+	if( strcmp( name, "null" ) == 0 ) {
+		return RENDER_BACKEND_NULL;
+	}
+	return -1;
+}
+
+void renderInvalidate( Renderer * r ) {
+	r->full = true;
+}
+
+// The theme called 'name', or NULL if there is none.
+Theme * renderFindTheme( char * name ) {
+	int i;
+	for( i = 0; i < N_RENDER_THEMES; i++ ) {
+		if( strcmp( render_themes[i].name, name ) == 0 ) {
+			return &render_themes[i];
+		}
+	}
+	return NULL;
+}
+
+void renderListThemes( FILE * f ) {
+	int i;
+	for( i = 0; i < N_RENDER_THEMES; i++ ) {
+		fprintf( f, i ? " %s" : "%s", render_themes[i].name );
+	}
+	fprintf( f, "\n" );
+}
+
+static chtype renderThemeGlyph( ThemeGlyph * g ) {
+	return (chtype)g->ch | colorAttr( g->fg, g->bg, g->bright, g->blink );
+}
+
+/* Fill the glyph table from a theme, and repaint everything with it on the
+   next frame. Curses colors must be set up already. */
+void renderSetTheme( Renderer * r, Theme * theme ) {
+	chtype empty = renderThemeGlyph( &theme->empty );
+	int i;
+	for( i = 0; i < RENDER_KINDS; i++ ) {
+		r->glyphs[i] = empty;
+	}
+	r->glyphs[CELL_WALL] = renderThemeGlyph( &theme->wall );
+	r->glyphs[CELL_APPLE] = renderThemeGlyph( &theme->apple );
+	r->glyphs[CELL_SNAKE] = renderThemeGlyph( &theme->body_even );
+	r->glyphs[CELL_SNAKE + 1] = renderThemeGlyph( &theme->body_odd );
+	r->head_glyph = renderThemeGlyph( &theme->head );
+	r->full = true;
+}
+
+// What window cell vx,vy should look like. The head is drawn over whatever is under it.
+// Anything past the edge of the arena is drawn as empty space.
+static chtype renderWant( Renderer * r, Arena * arena, int vx, int vy, Coord head ) {
+	int x = r->camera.x + vx;
+	int y = r->camera.y + vy;
+
+	if( x == head.x && y == head.y ) {
+		return r->head_glyph;
+	}
+	return renderGlyph( r, getCell( arena, x, y ) );
+}
+
+// Send n cells of the frame, starting at window cell vx,vy, to the backend.
+static void renderPut( Renderer * r, int vy, int vx, chtype * s, int n ) {
+	switch( r->backend ) {
+	case RENDER_BACKEND_CURSES:
+		mvaddchnstr( r->offset.y + vy, r->offset.x + vx, s, n );
+		break;
+	case RENDER_BACKEND_ANSI:
+		ansiPut( &r->ansi, r->offset.y + vy, r->offset.x + vx, s, n );
+		break;
+	default:
+		break;
+	}
+}
+
+// Bring one arena cell on screen up to date, if it is inside the window.
+static void renderCell( Renderer * r, Arena * arena, int x, int y, Coord head ) {
+	int vx = x - r->camera.x;
+	int vy = y - r->camera.y;
+	if( vx < 0 || vx >= r->w || vy < 0 || vy >= r->h ) {
+		return;
+	}
+
+	int i = vy * r->w + vx;
+	chtype want = renderWant( r, arena, vx, vy, head );
+
+	if( r->full || r->frame[i] != want ) {
+		r->frame[i] = want;
+		renderPut( r, vy, vx, &r->frame[i], 1 );
+	}
+}
+
+/* Bring a whole window row up to date. Each run of changed cells goes to
+   Curses as one chtype string, straight out of the frame, since every chtype
+   already carries its own color pair and attributes. */
+static void renderRow( Renderer * r, Arena * arena, int vy, Coord head ) {
+	chtype * frame = r->frame + vy * r->w;
+	int run = -1;	// Start of the current run of changed cells, if any.
+	int vx;
+
+	for( vx = 0; vx < r->w; vx++ ) {
+		chtype want = renderWant( r, arena, vx, vy, head );
+
+		if( r->full || frame[vx] != want ) {
+			frame[vx] = want;
+			if( run < 0 ) {
+				run = vx;
+			}
+		}
+		else if( run >= 0 ) {
+			renderPut( r, vy, run, frame + run, vx - run );
+			run = -1;
+		}
+	}
+	if( run >= 0 ) {
+		renderPut( r, vy, run, frame + run, vx - run );
+	}
+}
+
+// Move the camera along one axis so that 'pos' stays at least a margin away
+// from either edge of the window, without showing anything past the arena.
+static int renderFollowAxis( int camera, int pos, int view, int arena ) {
+	int margin = view / RENDER_SCROLL_MARGIN;
+
+	if( pos < camera + margin ) {
+		camera = pos - margin;
+	}
+	else if( pos > camera + view - 1 - margin ) {
+		camera = pos - (view - 1 - margin);
+	}
+
+	if( camera > arena - view ) {
+		camera = arena - view;
+	}
+	if( camera < 0 ) {
+		camera = 0;
+	}
+	return camera;
+}
+
+// Point the camera at the head. Returns true if it moved.
+static bool renderFollow( Renderer * r, Arena * arena, Coord head ) {
+	Coord old = r->camera;
+
+	if( head.x >= 0 ) {
+		r->camera.x = renderFollowAxis( r->camera.x, head.x, r->w, arena->w );
+		r->camera.y = renderFollowAxis( r->camera.y, head.y, r->h, arena->h );
+	}
+	return r->camera.x != old.x || r->camera.y != old.y;
+}
+
+void renderArena( Renderer * r, Game * game ) {
+	Arena * arena = &game->arena;
+
+	Coord head = { -1, -1 };
+	if( inBounds( arena, game->px, game->py ) ) {
+		head.x = game->px;
+		head.y = game->py;
+	}
+
+	// Attributes come from each chtype, so start from a clean slate.
+	if( r->backend == RENDER_BACKEND_CURSES ) {
+		attrset( A_NORMAL );
+	}
+
+	// A scrolled window is compared against the frame in full. Only the cells
+	// that really look different afterwards are sent to Curses.
+	bool scrolled = renderFollow( r, arena, head );
+
+	if( r->full || scrolled || arena->damage_all ) {
+		int vy;
+		for( vy = 0; vy < r->h; vy++ ) {
+			renderRow( r, arena, vy, head );
+		}
+	}
+	else {
+		int i;
+		for( i = 0; i < arena->n_damage; i++ ) {
+			renderCell( r, arena, arena->damage[i].x, arena->damage[i].y, head );
+		}
+		if( r->head.x >= 0 ) {
+			renderCell( r, arena, r->head.x, r->head.y, head );
+		}
+		if( head.x >= 0 ) {
+			renderCell( r, arena, head.x, head.y, head );
+		}
+	}
+
+	r->head = head;
+	r->full = false;
+	arenaClearDamage( arena );
+}
+
+// Print text at screen position x,y, outside the arena or over it, in the given attributes.
+void renderText( Renderer * r, int y, int x, attr_t attr, char * format, ... ) {
+	char text[256];
+	va_list args;
+	va_start( args, format );
+	vsnprintf( text, sizeof(text), format, args );
+	va_end( args );
+
+	switch( r->backend ) {
+	case RENDER_BACKEND_CURSES:
+		attrset( attr );
+		mvaddstr( y, x, text );
+		break;
+	case RENDER_BACKEND_ANSI:
+		ansiText( &r->ansi, y, x, attr, text );
+		break;
+	default:
+		break;
+	}
+}
+
+// Blank the whole screen. The arena is drawn in full on the next frame.
+void renderClear( Renderer * r ) {
+	switch( r->backend ) {
+	case RENDER_BACKEND_CURSES:
+		clear();
+		break;
+	case RENDER_BACKEND_ANSI:
+		ansiClear( &r->ansi, COLS );
+		break;
+	default:
+		break;
+	}
+	renderInvalidate( r );
+}
+
+// Put the frame on the terminal.
+void renderFlush( Renderer * r ) {
+	switch( r->backend ) {
+	case RENDER_BACKEND_CURSES:
+		refresh();
+		break;
+	case RENDER_BACKEND_ANSI:
+		// If any of it went missing, start again from a blank screen.
+		if( !ansiFlush( &r->ansi ) ) {
+			renderClear( r );
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+void renderLogStats( Renderer * r ) {
+	if( r->backend == RENDER_BACKEND_ANSI ) {
+		ansiLogStats( &r->ansi );
+	}
+}
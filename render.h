@@ -0,0 +1,103 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "curses.h"
+#include "draw.h"
+#include "board.h"			// Coord
+#include "game.h"
+#include "ansi.h"
+
+
+/* Incremental arena renderer. The arena can be much bigger than the screen,
+   so the renderer shows a w*h window onto it, and moves that window (the
+   camera) to keep the head away from the edges. It remembers what it last
+   put on the screen for every cell in the window, and on each frame only
+   looks at the cells the arena reports as damaged plus the old and new head
+   positions. Cells that come out the same as before are skipped, so the work
+   (and the bytes Curses sends to the terminal) follows what moved, and never
+   grows with the arena size. When the camera moves, the window is compared
+   in full, which costs w*h.
+
+   Anything that wipes the screen behind the renderer's back (clear(), a
+   terminal resize) must be followed by renderInvalidate().
+
+   Where the cells go is up to the backend, picked by renderInitBackend():
+   Curses (mvaddch() and refresh(), as always), raw ANSI sequences put
+   together in one buffer and written out with a single write() per frame
+   (see ansi.h), or nowhere at all, which leaves only the renderer's own
+   work to measure. Everything else on the screen during a game goes
+   through renderText(), renderClear() and renderFlush(), so that it reaches
+   the same place. With the ANSI backend, Curses is only used for the
+   keyboard, and stdscr must not be written to. */
+
+#define RENDER_BACKEND_CURSES 0
+#define RENDER_BACKEND_ANSI 1
+#define RENDER_BACKEND_NULL 2
+
+/* Themes. A Theme says how each kind of arena cell looks: its character,
+   colors and attributes. renderSetTheme() turns it into a table of finished
+   chtypes, indexed by cell kind, so drawing a cell is one lookup whatever the
+   theme, and the color pairs are only looked up once. Kinds are looked up by
+   their low bits, which puts CELL_SNAKE and CELL_SNAKE + 1 in slots of their
+   own, and a kind of -1 (past the edge of the arena) in the last slot, drawn
+   as empty space. */
+
+#define RENDER_KINDS 128
+
+typedef struct ThemeGlyph_t {
+	int ch;
+	int fg;
+	int bg;
+	bool bright;
+	bool blink;
+} ThemeGlyph;
+
+typedef struct Theme_t {
+	char * name;
+	ThemeGlyph empty;
+	ThemeGlyph wall;
+	ThemeGlyph apple;
+	ThemeGlyph body_even;	// CELL_SNAKE
+	ThemeGlyph body_odd;	// CELL_SNAKE + 1
+	ThemeGlyph head;
+} Theme;
+
+// How close the head may get to the edge of the window before it scrolls,
+// as a fraction of the window size.
+#define RENDER_SCROLL_MARGIN 4
+
+typedef struct Renderer_t {
+	int w;
+	int h;				// Size of the window, in cells.
+	Coord offset;		// Screen position of the top-left cell in the window.
+	Coord camera;		// Arena cell shown in the top-left of the window.
+
+	chtype * frame;		// What is on screen for each cell in the window, row by row.
+	Coord head;			// Arena cell the head was last drawn at, or -1,-1.
+	bool full;			// Redraw every cell on the next frame.
+
+	int backend;
+	AnsiTerm ansi;		// With RENDER_BACKEND_ANSI.
+
+	chtype glyphs[RENDER_KINDS];	// What each cell kind looks like, from the theme.
+	chtype head_glyph;
+} Renderer;
+
+bool renderInit( Renderer * r, int w, int h, Coord offset );
+bool renderInitBackend( Renderer * r, int w, int h, Coord offset, int backend, int fd );
+int renderFindBackend( char * name );
+void renderFree( Renderer * r );
+void renderInvalidate( Renderer * r );
+Theme * renderFindTheme( char * name );
+void renderListThemes( FILE * f );
+void renderSetTheme( Renderer * r, Theme * theme );
+void renderArena( Renderer * r, Game * game );
+void renderText( Renderer * r, int y, int x, attr_t attr, char * format, ... );
+void renderClear( Renderer * r );
+void renderFlush( Renderer * r );
+void renderLogStats( Renderer * r );
+
+#endif
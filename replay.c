@@ -0,0 +1,305 @@
+#include "replay.h"
+
+#define REPLAY_DIR_BITS 3
+#define REPLAY_INITIAL_CAP 4096
+
+bool replayInit( Replay * replay, uint64_t seed, int w, int h, int board_type ) {
+	memset( &replay->hdr, 0, sizeof(replay->hdr) );
+	memcpy( replay->hdr.magic, REPLAY_MAGIC, sizeof(replay->hdr.magic) );
+	replay->hdr.byte_order = REPLAY_BYTE_ORDER;
+	replay->hdr.version = REPLAY_VERSION;
+	replay->hdr.seed = seed;
+	replay->hdr.w = w;
+	replay->hdr.h = h;
+	replay->hdr.board_type = board_type;
+
+	replay->stream = malloc( REPLAY_INITIAL_CAP );
+	if( !replay->stream ) {
+		errLog( "replayInit(): malloc() failed on the turn stream." );
+		return false;
+	}
+	replay->cap = REPLAY_INITIAL_CAP;
+	replay->last_tick = 0;
+
+	return true;
+}
+
+void replayFree( Replay * replay ) {
+	free( replay->stream );
+	replay->stream = NULL;
+	replay->cap = 0;
+}
+
+// Append one varint to the stream, growing it if need be.
+static bool replayPutVarint( Replay * replay, uint64_t v ) {
+	if( replay->hdr.stream_size + 10 > replay->cap ) {
+		unsigned char * grown = realloc( replay->stream, replay->cap * 2 );
+		if( !grown ) {
+			errLog( "replayPutVarint(): realloc() failed at %zu bytes.", replay->cap * 2 );
+			return false;
+		}
+		replay->stream = grown;
+		replay->cap *= 2;
+	}
+
+	while( v >= 0x80 ) {
+		replay->stream[ replay->hdr.stream_size++ ] = (unsigned char)( v | 0x80 );
+		v >>= 7;
+	}
+	replay->stream[ replay->hdr.stream_size++ ] = (unsigned char)v;
+	return true;
+}
+
+/* Record the turn about to be passed to gameStep() for the game's current
+   tick. Turns that would not change anything are left out. Returns false if
+   the stream could not grow; the recording is then incomplete. */
+bool replayRecord( Replay * replay, Game * game, int dir ) {
+	if( !gameCanTurn( game, dir ) ) {
+		return true;
+	}
+	uint64_t delta = game->tick - replay->last_tick;
+	if( !replayPutVarint( replay, ( delta << REPLAY_DIR_BITS ) | dir ) ) {
+		return false;
+	}
+	replay->last_tick = game->tick;
+	replay->hdr.n_turns++;
+	return true;
+}
+
+// Mark where the recording stops.
+void replayEnd( Replay * replay, Game * game ) {
+	replay->hdr.n_ticks = game->tick;
+	replay->hdr.game_over = game->over;
+}
+
+bool replaySave( Replay * replay, char * filename ) {
+	FILE * f = fopen( filename, "wb" );
+	if( !f ) {
+		errLog( "replaySave(): Could not open %s for writing", filename );
+		return false;
+	}
+
+	bool ok = fwrite( &replay->hdr, sizeof(replay->hdr), 1, f ) == 1
+		&& fwrite( replay->stream, 1, replay->hdr.stream_size, f ) == replay->hdr.stream_size;
+	if( !ok ) {
+		errLog( "replaySave(): write failed on %s", filename );
+	}
+
+	if( fclose( f ) != 0 ) {
+		ok = false;
+	}
+	return ok;
+}
+
+/* Decode the turn at c->pos, if there is one, into the cursor. 'prev_tick' is
+   the tick of the turn before. Returns false if the stream is cut short. */
+static bool replayNext( Replay * replay, ReplayCursor * c, unsigned long prev_tick ) {
+	if( c->pos >= replay->hdr.stream_size ) {
+		c->has_next = false;
+		return true;
+	}
+
+	uint64_t v = 0;
+	int shift = 0;
+	unsigned char byte;
+	do {
+		if( c->pos >= replay->hdr.stream_size || shift > 63 ) {
+			return false;
+		}
+		byte = replay->stream[ c->pos++ ];
+		v |= (uint64_t)( byte & 0x7F ) << shift;
+		shift += 7;
+	} while( byte & 0x80 );
+
+	c->has_next = true;
+	c->next_tick = prev_tick + ( v >> REPLAY_DIR_BITS );
+	c->next_dir = (int)( v & ( ( 1 << REPLAY_DIR_BITS ) - 1 ) );
+	return true;
+}
+
+// Go through the whole stream once, so that a damaged file is caught on loading rather than halfway through playing it.
+static bool replayCheck( Replay * replay, char * filename ) {
+	ReplayCursor c;
+	c.pos = 0;
+	unsigned long tick = 0;
+	uint32_t n = 0;
+	for( ;; ) {
+		if( !replayNext( replay, &c, tick ) ) {
+			errLog( "replayLoad(): %s: turn %u is cut short.", filename, n );
+			return false;
+		}
+		if( !c.has_next ) {
+			break;
+		}
+		if( c.next_dir < DIR_EAST || c.next_dir > DIR_SOUTH || c.next_tick > replay->hdr.n_ticks ) {
+			errLog( "replayLoad(): %s: turn %u (tick %lu, direction %d) is not valid.",
+				filename, n, c.next_tick, c.next_dir );
+			return false;
+		}
+		tick = c.next_tick;
+		n++;
+	}
+	if( n != replay->hdr.n_turns ) {
+		errLog( "replayLoad(): %s holds %u turns; the header says %u.", filename, n, replay->hdr.n_turns );
+		return false;
+	}
+	replay->last_tick = tick;
+	return true;
+}
+
+bool replayLoad( Replay * replay, char * filename ) {
+	replay->stream = NULL;
+	replay->cap = 0;
+
+	FILE * f = fopen( filename, "rb" );
+	if( !f ) {
+		errLog( "replayLoad(): Could not open %s", filename );
+		return false;
+	}
+
+	ReplayHeader * hdr = &replay->hdr;
+	if( fread( hdr, sizeof(*hdr), 1, f ) != 1 || memcmp( hdr->magic, REPLAY_MAGIC, sizeof(hdr->magic) ) != 0 ) {
+		errLog( "replayLoad(): %s is not a replay file.", filename );
+		fclose( f );
+		return false;
+	}
+	if( hdr->byte_order != REPLAY_BYTE_ORDER || hdr->version != REPLAY_VERSION ) {
+		errLog( "replayLoad(): %s was written by another version or byte order (version %u, order 0x%08x).",
+			filename, hdr->version, hdr->byte_order );
+		fclose( f );
+		return false;
+	}
+	if( hdr->w < 3 || hdr->h < 3 || hdr->w > INT_MAX || hdr->h > INT_MAX || hdr->board_type > BOARDTYPE_CROSS ) {
+		errLog( "replayLoad(): %s has a bad arena (w%u h%u type %u).", filename, hdr->w, hdr->h, hdr->board_type );
+		fclose( f );
+		return false;
+	}
+
+	replay->cap = hdr->stream_size > 0 ? hdr->stream_size : 1;
+	replay->stream = malloc( replay->cap );
+	if( !replay->stream ) {
+		errLog( "replayLoad(): malloc() failed on %llu bytes of turns in %s.",
+			(unsigned long long)hdr->stream_size, filename );
+		fclose( f );
+		return false;
+	}
+	bool ok = fread( replay->stream, 1, hdr->stream_size, f ) == hdr->stream_size;
+	fclose( f );
+	if( !ok ) {
+		errLog( "replayLoad(): %s ends before its turns do.", filename );
+	}
+
+	if( !ok || !replayCheck( replay, filename ) ) {
+		replayFree( replay );
+		return false;
+	}
+	return true;
+}
+
+// Keep a copy of the game where it is now.
+static bool replaySnapshot( ReplayPlayer * p ) {
+	if( p->n_snaps == p->cap_snaps ) {
+		int cap = p->cap_snaps ? p->cap_snaps * 2 : 16;
+		ReplaySnapshot * grown = realloc( p->snaps, sizeof(ReplaySnapshot) * cap );
+		if( !grown ) {
+			errLog( "replaySnapshot(): realloc() failed on %d snapshots.", cap );
+			return false;
+		}
+		p->snaps = grown;
+		p->cap_snaps = cap;
+	}
+
+	ReplaySnapshot * s = &p->snaps[ p->n_snaps ];
+	if( !gameCopy( &s->game, &p->game ) ) {
+		errLog( "replaySnapshot(): gameCopy() failed at tick %lu.", p->game.tick );
+		return false;
+	}
+	s->cursor = p->cursor;
+	p->n_snaps++;
+	return true;
+}
+
+bool replayPlayerInit( ReplayPlayer * p, Replay * replay ) {
+	p->replay = replay;
+	p->snaps = NULL;
+	p->n_snaps = 0;
+	p->cap_snaps = 0;
+	p->n_restores = 0;
+
+	Rng rng;
+	rngSeed( &rng, replay->hdr.seed );
+	if( !gameInit( &p->game, replay->hdr.w, replay->hdr.h, replay->hdr.board_type, &rng ) ) {
+		errLog( "replayPlayerInit(): gameInit() failed." );
+		return false;
+	}
+
+	p->cursor.pos = 0;
+	replayNext( replay, &p->cursor, 0 );
+	if( !replaySnapshot( p ) ) {
+		gameFree( &p->game );
+		return false;
+	}
+	return true;
+}
+
+void replayPlayerFree( ReplayPlayer * p ) {
+	int i;
+	for( i = 0; i < p->n_snaps; i++ ) {
+		gameFree( &p->snaps[i].game );
+	}
+	free( p->snaps );
+	p->snaps = NULL;
+	p->n_snaps = 0;
+	gameFree( &p->game );
+}
+
+// Run one tick, with the recorded turn if there is one for it.
+static void replayStep( ReplayPlayer * p ) {
+	int dir = DIR_NONE;
+	if( p->cursor.has_next && p->cursor.next_tick == p->game.tick ) {
+		dir = p->cursor.next_dir;
+		replayNext( p->replay, &p->cursor, p->cursor.next_tick );
+	}
+	gameStep( &p->game, dir );
+}
+
+/* Bring the game to 'tick': forward from where it is, or from the latest
+   snapshot at or before 'tick' if that is closer. Stops early if the game
+   ends first, or the recording does. Returns false only if a snapshot could
+   not be taken or restored. */
+bool replaySeek( ReplayPlayer * p, unsigned long tick ) {
+	if( tick > p->replay->hdr.n_ticks ) {
+		tick = p->replay->hdr.n_ticks;
+	}
+
+	int s = (int)( tick / REPLAY_SNAPSHOT_TICKS );
+	if( s >= p->n_snaps ) {
+		s = p->n_snaps - 1;
+	}
+	if( tick < p->game.tick || p->snaps[s].game.tick > p->game.tick ) {
+		gameFree( &p->game );
+		if( !gameCopy( &p->game, &p->snaps[s].game ) ) {
+			errLog( "replaySeek(): gameCopy() failed restoring tick %lu.", p->snaps[s].game.tick );
+			return false;
+		}
+		p->cursor = p->snaps[s].cursor;
+		p->n_restores++;
+	}
+
+	while( p->game.tick < tick && !p->game.over ) {
+		replayStep( p );
+
+		// Snapshots are taken the first time through each stretch, and are then there to seek back to.
+		if( p->game.tick % REPLAY_SNAPSHOT_TICKS == 0 && (unsigned long)p->n_snaps == p->game.tick / REPLAY_SNAPSHOT_TICKS ) {
+			if( !replaySnapshot( p ) ) {
+				return false;
+			}
+		}
+	}
+
+	// The step that ends a game does not count as a tick, so the last tick of a lost game still needs it.
+	if( tick == p->replay->hdr.n_ticks && p->replay->hdr.game_over && !p->game.over ) {
+		replayStep( p );
+	}
+	return true;
+}
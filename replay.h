@@ -0,0 +1,98 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "error_handler.h"
+#include "game.h"
+
+
+/* Recording and replaying games. A game only depends on its seed, its arena
+   and the turn taken on each tick (see game.h), so that is all a Replay
+   keeps: a ReplayHeader, then the turns as a byte stream.
+
+   Most ticks have no turn, so only the ticks that do are stored, each as one
+   varint (7 bits a byte, low bits first) holding the number of ticks since
+   the turn before, shifted up three bits, with the direction in the bottom
+   three bits. A turn every few ticks costs about a byte. Turns the Snek
+   could not make are never recorded.
+
+   A ReplayPlayer runs a replay headless, as fast as gameStep() goes. On the
+   way it keeps a copy of the game every REPLAY_SNAPSHOT_TICKS ticks, so
+   going back to an earlier tick means restoring the nearest snapshot before
+   it and stepping forward from there, rather than starting over. A snapshot
+   shares everything with the game until the game writes to it (see
+   gameCopy()), so each one only costs the tiles written since the one
+   before. Comparing gameHash() at chosen ticks against another build, or
+   against a snapshot, narrows down where a long run first went wrong.
+
+   On disk, the header is followed by the stream. Like the binary board
+   format, numbers are in the writer's byte order, which byte_order shows. */
+
+#define REPLAY_MAGIC "SNEKRPL"			// 8 bytes, with the terminator.
+#define REPLAY_VERSION 1
+#define REPLAY_BYTE_ORDER 0x01020304
+
+#define REPLAY_SNAPSHOT_TICKS 1024
+
+typedef struct ReplayHeader_t {
+	char magic[8];
+	uint32_t byte_order;
+	uint32_t version;
+	uint64_t seed;
+	uint32_t w;
+	uint32_t h;
+	uint32_t board_type;
+	uint32_t n_turns;
+	uint32_t game_over;		// Whether the game had ended, on tick n_ticks.
+	uint32_t reserved;
+	uint64_t n_ticks;		// Ticks played when the recording ended.
+	uint64_t stream_size;	// Bytes of turn stream after the header.
+} ReplayHeader;
+
+typedef struct Replay_t {
+	ReplayHeader hdr;
+	unsigned char * stream;
+	size_t cap;
+	unsigned long last_tick;	// Tick of the last recorded turn.
+} Replay;
+
+// Where a player is in the stream: the next turn and the offset just past it.
+typedef struct ReplayCursor_t {
+	size_t pos;
+	bool has_next;
+	unsigned long next_tick;
+	int next_dir;
+} ReplayCursor;
+
+typedef struct ReplaySnapshot_t {
+	Game game;
+	ReplayCursor cursor;
+} ReplaySnapshot;
+
+typedef struct ReplayPlayer_t {
+	Replay * replay;
+	Game game;
+	ReplayCursor cursor;
+
+	ReplaySnapshot * snaps;		// In tick order, starting at tick 0.
+	int n_snaps;
+	int cap_snaps;
+	long n_restores;
+} ReplayPlayer;
+
+bool replayInit( Replay * replay, uint64_t seed, int w, int h, int board_type );
+void replayFree( Replay * replay );
+bool replayRecord( Replay * replay, Game * game, int dir );
+void replayEnd( Replay * replay, Game * game );
+bool replaySave( Replay * replay, char * filename );
+bool replayLoad( Replay * replay, char * filename );
+
+bool replayPlayerInit( ReplayPlayer * p, Replay * replay );
+void replayPlayerFree( ReplayPlayer * p );
+bool replaySeek( ReplayPlayer * p, unsigned long tick );
+
+#endif
@@ -0,0 +1,83 @@
+#include "rng.h"
+
+static uint64_t rotl( uint64_t x, int k ) {
+	return ( x << k ) | ( x >> ( 64 - k ) );
+}
+
+void rngSeed( Rng * rng, uint64_t seed ) {
+	int i;
+	for( i = 0; i < 4; i++ ) {
+		// SplitMix64
+		uint64_t z = ( seed += 0x9E3779B97F4A7C15ULL );
+		z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+		z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+		rng->s[i] = z ^ ( z >> 31 );
+	}
+}
+
+uint64_t rngNext( Rng * rng ) {
+	uint64_t * s = rng->s;
+	uint64_t result = rotl( s[1] * 5, 7 ) * 9;
+	uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl( s[3], 45 );
+
+	return result;
+}
+
+/* A number from 0 to n - 1, every one equally likely (n > 0). Uses the high
+   half of a 64x64-bit multiply rather than a modulo, and only retries in the
+   rare case that the low half falls in the short, biased zone (Lemire). */
+uint64_t rngBelow( Rng * rng, uint64_t n ) {
+	unsigned __int128 m = (unsigned __int128)rngNext( rng ) * n;
+	uint64_t low = (uint64_t)m;
+
+	if( low < n ) {
+		uint64_t threshold = -n % n;
+		while( low < threshold ) {
+			m = (unsigned __int128)rngNext( rng ) * n;
+			low = (uint64_t)m;
+		}
+	}
+	return (uint64_t)( m >> 64 );
+}
+
+// Advance the state by the number of rngNext() calls that the jump polynomial stands for.
+static void rngJumpBy( Rng * rng, const uint64_t poly[4] ) {
+	uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	int i, b;
+	for( i = 0; i < 4; i++ ) {
+		for( b = 0; b < 64; b++ ) {
+			if( poly[i] & ( (uint64_t)1 << b ) ) {
+				s0 ^= rng->s[0];
+				s1 ^= rng->s[1];
+				s2 ^= rng->s[2];
+				s3 ^= rng->s[3];
+			}
+			rngNext( rng );
+		}
+	}
+	rng->s[0] = s0;
+	rng->s[1] = s1;
+	rng->s[2] = s2;
+	rng->s[3] = s3;
+}
+
+// Same as 2^128 calls to rngNext().
+void rngJump( Rng * rng ) {
+	static const uint64_t poly[4] = {
+		0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL, 0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL };
+	rngJumpBy( rng, poly );
+}
+
+// Same as 2^192 calls to rngNext().
+void rngLongJump( Rng * rng ) {
+	static const uint64_t poly[4] = {
+		0x76E15D3EFEFDCBBFULL, 0xC5004E441C522FB3ULL, 0x77710069854EE241ULL, 0x39109BB02ACBE635ULL };
+	rngJumpBy( rng, poly );
+}
@@ -0,0 +1,26 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+
+/* Small, fast pseudo-random number generator: xoshiro256** (Blackman and
+   Vigna), 32 bytes of state. Each Game carries its own, so games do not
+   share any random state and the same seed always gives the same game.
+
+   rngSeed() spreads a 64-bit seed over the whole state with SplitMix64, so
+   nearby seeds still give unrelated sequences. rngJump() advances a state by
+   2^128 steps, and rngLongJump() by 2^192: seed once, then jump to get as
+   many non-overlapping streams as needed (one per game in a batch run, say). */
+
+typedef struct Rng_t {
+	uint64_t s[4];
+} Rng;
+
+void rngSeed( Rng * rng, uint64_t seed );
+uint64_t rngNext( Rng * rng );
+uint64_t rngBelow( Rng * rng, uint64_t n );
+void rngJump( Rng * rng );
+void rngLongJump( Rng * rng );
+
+#endif
@@ -0,0 +1,392 @@
+/* Snek batch simulator
+
+   Plays many complete games headless, spread over a pool of worker threads,
+   and prints the score distribution for each arena type as one JSON object
+   per line:
+
+     {"sim":"cross","player":"auto","w":23,"h":23,"games":...,"apples_mean":...,"apples_max":...,
+      "ticks_mean":...,"timeouts":...,"histogram":[...]}
+
+   followed by one "total" line with the thread count and games per second.
+   histogram[i] counts the games that ended with i apples eaten; the last
+   bucket also takes everything above it.
+
+   The games are played by the autopilot (autopilot.h), or with --player
+   random, by a simple player that turns at random and takes apples that are
+   right next to it.
+
+   Every game is independent: it has its own Game (arena tiles, Snek) and its
+   own random state. Game j plays from the j'th jump (2^128 draws) along the
+   stream seeded with the base seed, and its player from a long jump (2^192)
+   past that, so no two streams can overlap, and the results are the same
+   whatever the thread count or scheduling. Workers keep
+   their own totals, which are merged once they have all finished.
+
+   Scheduling is work stealing. The games are dealt out to the workers in
+   equal runs up front; a worker takes games from the front of its own run,
+   and once that is empty, steals the back half of the longest run left.
+
+   Usage: snek_sim [--games N] [--threads N] [--board empty|cross|all]
+                   [--size W H] [--seed N] [--player auto|random] [--max-ticks N] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "error_handler.h"
+#include "game.h"
+#include "autopilot.h"
+
+#define SIM_HIST_MAX 256
+#define SIM_MAX_THREADS 256
+
+static const int sim_boards[] = { BOARDTYPE_EMPTY, BOARDTYPE_CROSS };
+static char * sim_board_names[] = { "empty", "cross" };
+#define N_SIM_BOARDS (int)(sizeof(sim_boards) / sizeof(sim_boards[0]))
+
+// Totals for one arena type.
+typedef struct SimStats_t {
+	long games;
+	long timeouts;			// Games stopped at max_ticks.
+	long long apples;
+	long long ticks;
+	int apples_max;
+	long histogram[SIM_HIST_MAX];
+} SimStats;
+
+// A worker's run of games still to play: next .. end - 1.
+typedef struct SimQueue_t {
+	pthread_mutex_t lock;
+	long next;
+	long end;
+} SimQueue;
+
+typedef struct SimWorker_t {
+	pthread_t thread;
+	int id;
+	SimStats stats[N_SIM_BOARDS];
+	long stolen;
+	Autopilot ap;
+} SimWorker;
+
+// Settings. Read-only once the workers start.
+static long n_games = 1000;
+static int n_threads = 0;
+static int board_first = 0;
+static int board_last = N_SIM_BOARDS - 1;
+static int arena_w = 23;
+static int arena_h = 23;
+static uint64_t base_seed = 1;
+static unsigned long max_ticks = 0;
+static bool use_autopilot = true;
+
+static Rng * streams;		// One per game number, shared by the arena types.
+
+static SimQueue queues[SIM_MAX_THREADS];
+static SimWorker workers[SIM_MAX_THREADS];
+
+static double nowNs( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* The random player: go for an apple next to the head, otherwise keep
+   going, turning at random now and then, and whenever the way ahead is
+   blocked. Picks among the safe directions with its own random state. */
+static int simPlayer( Game * game, Rng * rng ) {
+	static const int dirs[4] = { DIR_EAST, DIR_SOUTH, DIR_WEST, DIR_NORTH };
+	static const int dx[4] = { 1, 0, -1, 0 };
+	static const int dy[4] = { 0, 1, 0, -1 };
+
+	int safe[4];
+	int n_safe = 0;
+	int ahead = -1;
+	int d;
+	for( d = 0; d < 4; d++ ) {
+		if( dirs[d] != game->pdir && !gameCanTurn( game, dirs[d] ) ) {
+			continue;
+		}
+		int kind = getCell( &game->arena, game->px + dx[d], game->py + dy[d] );
+		if( kind == CELL_APPLE ) {
+			return dirs[d];
+		}
+		if( kind == CELL_EMPTY ) {
+			if( dirs[d] == game->pdir ) {
+				ahead = d;
+			}
+			safe[ n_safe++ ] = d;
+		}
+	}
+
+	if( ahead >= 0 && rngBelow( rng, 8 ) != 0 ) {
+		return DIR_NONE;
+	}
+	if( n_safe == 0 ) {
+		return DIR_NONE;
+	}
+	return dirs[ safe[ rngBelow( rng, n_safe ) ] ];
+}
+
+// Play game number 'job' to the end and add it to the worker's totals.
+static void simPlay( SimWorker * w, long job ) {
+	int b = board_first + (int)( job / n_games );
+	Rng rng = streams[ job % n_games ];
+	rngLongJump( &rng );
+
+	Game game;
+	if( !gameInit( &game, arena_w, arena_h, sim_boards[b], &streams[ job % n_games ] ) ) {
+		errQuit( "FATAL: simPlay(): gameInit() failed." );
+	}
+
+	unsigned long limit = max_ticks ? max_ticks : (unsigned long)arena_w * arena_h * 64;
+	autopilotReset( &w->ap );
+	while( game.tick < limit ) {
+		int dir = use_autopilot ? autopilotNextTurn( &w->ap, &game ) : simPlayer( &game, &rng );
+		if( gameStep( &game, dir ) == STEP_GAME_OVER ) {
+			break;
+		}
+	}
+
+	SimStats * s = &w->stats[b];
+	s->games++;
+	s->timeouts += !game.over;
+	s->apples += game.n_apples;
+	s->ticks += game.tick;
+	if( game.n_apples > s->apples_max ) {
+		s->apples_max = game.n_apples;
+	}
+	s->histogram[ game.n_apples < SIM_HIST_MAX ? game.n_apples : SIM_HIST_MAX - 1 ]++;
+
+	gameFree( &game );
+}
+
+static bool simTake( SimQueue * q, long * job ) {
+	bool ok = false;
+	pthread_mutex_lock( &q->lock );
+	if( q->next < q->end ) {
+		*job = q->next++;
+		ok = true;
+	}
+	pthread_mutex_unlock( &q->lock );
+	return ok;
+}
+
+/* Take the back half of the longest run left, keep its first game in *job
+   and make the rest this worker's own run. Returns false once every run is
+   empty; since games are never added, the worker is then done. */
+static bool simSteal( SimWorker * w, long * job ) {
+	for( ;; ) {
+		int victim = -1;
+		long most = 0;
+		int i;
+		for( i = 0; i < n_threads; i++ ) {
+			if( i == w->id ) {
+				continue;
+			}
+			// Only a hint: the run may shrink before it is locked again below.
+			pthread_mutex_lock( &queues[i].lock );
+			long left = queues[i].end - queues[i].next;
+			pthread_mutex_unlock( &queues[i].lock );
+			if( left > most ) {
+				most = left;
+				victim = i;
+			}
+		}
+		if( victim < 0 ) {
+			return false;
+		}
+
+		SimQueue * q = &queues[victim];
+		pthread_mutex_lock( &q->lock );
+		long left = q->end - q->next;
+		if( left < 1 ) {
+			pthread_mutex_unlock( &q->lock );
+			continue;
+		}
+		long from = q->end - ( left + 1 ) / 2;
+		long to = q->end;
+		q->end = from;
+		pthread_mutex_unlock( &q->lock );
+
+		SimQueue * mine = &queues[ w->id ];
+		pthread_mutex_lock( &mine->lock );
+		mine->next = from + 1;
+		mine->end = to;
+		pthread_mutex_unlock( &mine->lock );
+
+		w->stolen += to - from;
+		*job = from;
+		return true;
+	}
+}
+
+static void * simWorker( void * arg ) {
+	SimWorker * w = arg;
+	long job;
+
+	while( simTake( &queues[ w->id ], &job ) || simSteal( w, &job ) ) {
+		simPlay( w, job );
+	}
+	return NULL;
+}
+
+static void simMerge( SimStats * into, SimStats * from ) {
+	into->games += from->games;
+	into->timeouts += from->timeouts;
+	into->apples += from->apples;
+	into->ticks += from->ticks;
+	if( from->apples_max > into->apples_max ) {
+		into->apples_max = from->apples_max;
+	}
+	int i;
+	for( i = 0; i < SIM_HIST_MAX; i++ ) {
+		into->histogram[i] += from->histogram[i];
+	}
+}
+
+static void simReport( char * name, SimStats * s ) {
+	// Drop the empty buckets off the end of the histogram.
+	int last = SIM_HIST_MAX - 1;
+	while( last > 0 && s->histogram[last] == 0 ) {
+		last--;
+	}
+
+	printf( "{\"sim\":\"%s\",\"player\":\"%s\",\"version\":\"%s\",\"w\":%d,\"h\":%d,\"games\":%ld,"
+		"\"apples_mean\":%.3f,\"apples_max\":%d,\"ticks_mean\":%.1f,\"timeouts\":%ld,\"histogram\":[",
+		name, use_autopilot ? "auto" : "random", SNEK_VERSION, arena_w, arena_h, s->games,
+		(double)s->apples / s->games, s->apples_max, (double)s->ticks / s->games, s->timeouts );
+	int i;
+	for( i = 0; i <= last; i++ ) {
+		printf( i ? ",%ld" : "%ld", s->histogram[i] );
+	}
+	printf( "]}\n" );
+}
+
+static int usage( char * name ) {
+	fprintf( stderr, "Usage: %s [--games N] [--threads N] [--board empty|cross|all] "
+		"[--size W H] [--seed N] [--player auto|random] [--max-ticks N]\n", name );
+	return 1;
+}
+
+int main( int argc, char *argv[] ) {
+	int i;
+	for( i = 1; i < argc; i++ ) {
+		if( strcmp( argv[i], "--games" ) == 0 && i + 1 < argc ) {
+			n_games = atol( argv[++i] );
+		}
+		else if( strcmp( argv[i], "--threads" ) == 0 && i + 1 < argc ) {
+			n_threads = atoi( argv[++i] );
+		}
+		else if( strcmp( argv[i], "--board" ) == 0 && i + 1 < argc ) {
+			i++;
+			if( strcmp( argv[i], "empty" ) == 0 ) {
+				board_first = board_last = 0;
+			}
+			else if( strcmp( argv[i], "cross" ) == 0 ) {
+				board_first = board_last = 1;
+			}
+			else if( strcmp( argv[i], "all" ) != 0 ) {
+				return usage( argv[0] );
+			}
+		}
+		else if( strcmp( argv[i], "--size" ) == 0 && i + 2 < argc ) {
+			arena_w = atoi( argv[++i] );
+			arena_h = atoi( argv[++i] );
+		}
+		else if( strcmp( argv[i], "--seed" ) == 0 && i + 1 < argc ) {
+			base_seed = strtoull( argv[++i], NULL, 10 );
+		}
+		else if( strcmp( argv[i], "--player" ) == 0 && i + 1 < argc ) {
+			i++;
+			if( strcmp( argv[i], "random" ) == 0 ) {
+				use_autopilot = false;
+			}
+			else if( strcmp( argv[i], "auto" ) != 0 ) {
+				return usage( argv[0] );
+			}
+		}
+		else if( strcmp( argv[i], "--max-ticks" ) == 0 && i + 1 < argc ) {
+			max_ticks = strtoul( argv[++i], NULL, 10 );
+		}
+		else {
+			return usage( argv[0] );
+		}
+	}
+	if( n_threads < 1 ) {
+		n_threads = (int)sysconf( _SC_NPROCESSORS_ONLN );
+	}
+	if( n_threads < 1 || n_threads > SIM_MAX_THREADS ) {
+		n_threads = n_threads < 1 ? 1 : SIM_MAX_THREADS;
+	}
+	if( n_games < 1 || arena_w < 3 || arena_h < 3 ) {
+		return usage( argv[0] );
+	}
+
+	errorHandlerInit( &error_handler, 1 );
+
+	// Split the base stream up between the games before any worker starts.
+	streams = malloc( sizeof(Rng) * n_games );
+	if( !streams ) {
+		errQuit( "FATAL: main(): malloc() failed on %ld random streams.", n_games );
+	}
+	Rng master;
+	rngSeed( &master, base_seed );
+	long j;
+	for( j = 0; j < n_games; j++ ) {
+		streams[j] = master;
+		rngJump( &master );
+	}
+
+	// Deal the games out in equal runs.
+	long n_jobs = n_games * ( board_last - board_first + 1 );
+	for( i = 0; i < n_threads; i++ ) {
+		pthread_mutex_init( &queues[i].lock, NULL );
+		queues[i].next = n_jobs * i / n_threads;
+		queues[i].end = n_jobs * ( i + 1 ) / n_threads;
+		memset( &workers[i], 0, sizeof(SimWorker) );
+		workers[i].id = i;
+		if( use_autopilot && !autopilotInit( &workers[i].ap ) ) {
+			errQuit( "FATAL: main(): autopilotInit() failed on worker %d.", i );
+		}
+	}
+
+	double start = nowNs();
+	for( i = 0; i < n_threads; i++ ) {
+		if( pthread_create( &workers[i].thread, NULL, simWorker, &workers[i] ) != 0 ) {
+			errQuit( "FATAL: main(): pthread_create() failed on worker %d.", i );
+		}
+	}
+	long stolen = 0;
+	for( i = 0; i < n_threads; i++ ) {
+		pthread_join( workers[i].thread, NULL );
+		stolen += workers[i].stolen;
+		if( use_autopilot ) {
+			autopilotFree( &workers[i].ap );
+		}
+	}
+	double elapsed = nowNs() - start;
+
+	SimStats total[N_SIM_BOARDS];
+	memset( total, 0, sizeof(total) );
+	int b;
+	for( i = 0; i < n_threads; i++ ) {
+		for( b = board_first; b <= board_last; b++ ) {
+			simMerge( &total[b], &workers[i].stats[b] );
+		}
+	}
+	for( b = board_first; b <= board_last; b++ ) {
+		simReport( sim_board_names[b], &total[b] );
+	}
+	printf( "{\"sim\":\"total\",\"version\":\"%s\",\"games\":%ld,\"threads\":%d,\"stolen\":%ld,"
+		"\"elapsed_s\":%.3f,\"games_per_sec\":%.1f}\n",
+		SNEK_VERSION, n_jobs, n_threads, stolen, elapsed / 1e9, n_jobs / ( elapsed / 1e9 ) );
+
+	free( streams );
+	errorHandlerShutdown( &error_handler );
+	return 0;
+}
@@ -0,0 +1,124 @@
+#include "snake.h"
+
+static SnakeBody * bodyAlloc( int cap ) {
+	SnakeBody * body = malloc( sizeof(SnakeBody) + cap * sizeof(Coord) );
+	if( body ) {
+		body->refs = 1;
+	}
+	return body;
+}
+
+static void bodyUnref( SnakeBody * body ) {
+	if( body && --body->refs == 0 ) {
+		free( body );
+	}
+}
+
+bool snakeInit( Snake * snake, int cap ) {
+	// Round up to a power of two so that wrapping is a mask instead of a modulo.
+	int real_cap = 1;
+	while( real_cap < cap ) {
+		real_cap *= 2;
+	}
+
+	snake->body = bodyAlloc( real_cap );
+	if( !snake->body ) {
+		errLog( "snakeInit(): malloc() failed on snake->body" );
+		return false;
+	}
+	snake->body->floor = 0;
+	snake->body->front = 0;
+	snake->cap = real_cap;
+	snake->len = 0;
+	snake->pushed = 0;
+
+	return true;
+}
+
+// Make 'dst' a copy of 'src' in constant time, sharing the body buffer. 'dst' must not be set up already.
+bool snakeCopy( Snake * dst, Snake * src ) {
+	*dst = *src;
+	dst->body->refs++;
+	return true;
+}
+
+void snakeFree( Snake * snake ) {
+	bodyUnref( snake->body );
+	snake->body = NULL;
+	snake->cap = 0;
+	snake->len = 0;
+}
+
+/* Move the body to a buffer of this Snek's own, 'new_cap' slots long. Segments
+   keep their numbers, so they land at the same place modulo the new size. */
+static bool snakeMove( Snake * snake, int new_cap ) {
+	SnakeBody * body = bodyAlloc( new_cap );
+	if( !body ) {
+		errLog( "snakeMove(): malloc() failed on %d segments", new_cap );
+		return false;
+	}
+
+	unsigned int tail = snake->pushed - snake->len;
+	unsigned int i;
+	for( i = tail; i != snake->pushed; i++ ) {
+		body->seg[ i & (new_cap - 1) ] = snake->body->seg[ i & (snake->cap - 1) ];
+	}
+	body->floor = tail;
+	body->front = snake->pushed;
+
+	bodyUnref( snake->body );
+	snake->body = body;
+	snake->cap = new_cap;
+
+	return true;
+}
+
+bool snakePushHead( Snake * snake, int x, int y ) {
+	SnakeBody * body = snake->body;
+	unsigned int head = snake->pushed;
+
+	// Alone, the slot after the head is free unless the ring is full. Shared, see snake.h.
+	bool in_place;
+	if( body->refs == 1 ) {
+		body->floor = head - snake->len;
+		in_place = snake->len < snake->cap;
+	}
+	else {
+		in_place = body->front == head && head - body->floor < (unsigned int)snake->cap;
+	}
+
+	if( !in_place ) {
+		// Leave room for copies that lag behind, so that moving again is not needed soon.
+		int new_cap = snake->cap;
+		if( snake->len * 2 > new_cap ) {
+			new_cap *= 2;
+		}
+		if( !snakeMove( snake, new_cap ) ) {
+			return false;
+		}
+		body = snake->body;
+	}
+
+	Coord * seg = &body->seg[ head & (snake->cap - 1) ];
+	seg->x = x;
+	seg->y = y;
+	snake->len++;
+	snake->pushed++;
+	body->front = snake->pushed;
+
+	return true;
+}
+
+Coord snakePopTail( Snake * snake ) {
+	Coord old = { -1, -1 };
+	if( snake->len > 0 ) {
+		old = snake->body->seg[ (snake->pushed - snake->len) & (snake->cap - 1) ];
+		snake->len--;
+	}
+	return old;
+}
+
+// Segment 0 is the tail, segment len - 1 is the newest (the one behind the head).
+Coord snakeGetSegment( Snake * snake, int i ) {
+	return snake->body->seg[ (snake->pushed - snake->len + i) & (snake->cap - 1) ];
+}
@@ -0,0 +1,47 @@
+#ifndef SNAKE_H
+#define SNAKE_H
+
+#include <stdbool.h>
+
+#include "error_handler.h"
+#include "board.h"			// Coord
+
+
+/* The Snek body, kept as a ring buffer of cell coordinates running from tail
+   to head. Moving only ever touches the two ends, so a tick costs the same no
+   matter how large the arena or how long the Snek gets. The buffer doubles in
+   size when the Snek outgrows it.
+
+   Segments are numbered by when they were pushed: the head goes in slot
+   'pushed' of the ring, and the tail is at 'pushed - len'. Because popping the
+   tail never writes to the buffer, snakeCopy() can share it in constant time.
+   A copy that pushes may write in place as long as nobody else has pushed
+   past it and the slot is not part of any sharer's body: every sharer's body
+   lies between the buffer's 'floor' (the oldest tail when it was shared) and
+   'front' (the newest head written). Otherwise it first takes a copy of its
+   own. The reference count is not atomic; copies stay on one thread. */
+
+typedef struct SnakeBody_t {
+	int refs;
+	unsigned int floor;		// No sharer's tail is older than this.
+	unsigned int front;		// One past the newest segment written by anyone.
+	Coord seg[];
+} SnakeBody;
+
+typedef struct Snake_t {
+	SnakeBody * body;
+	int cap;		// Slots in body->seg[]. Always a power of two.
+	int len;		// Number of segments currently stored.
+	unsigned int pushed;	// Segments pushed so far. Used to alternate body glyphs.
+} Snake;
+
+#define SNAKE_INITIAL_CAP 64
+
+bool snakeInit( Snake * snake, int cap );
+bool snakeCopy( Snake * dst, Snake * src );
+void snakeFree( Snake * snake );
+bool snakePushHead( Snake * snake, int x, int y );
+Coord snakePopTail( Snake * snake );
+Coord snakeGetSegment( Snake * snake, int i );
+
+#endif
@@ -0,0 +1,97 @@
+#include "ticker.h"
+
+static long long timespecDiffNs( struct timespec * a, struct timespec * b ) {
+	return ( a->tv_sec - b->tv_sec ) * 1000000000LL + ( a->tv_nsec - b->tv_nsec );
+}
+
+bool tickerInit( Ticker * t, long period_ms ) {
+	if( period_ms < 1 ) {
+		errLog( "tickerInit(): invalid tick period (%ld ms).", period_ms );
+		return false;
+	}
+
+	t->fd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+	if( t->fd < 0 ) {
+		errLog( "tickerInit(): timerfd_create() failed." );
+		return false;
+	}
+	t->period_ns = period_ms * 1000000L;
+	t->running = false;
+	t->due = 0;
+
+	t->n_ticks = 0;
+	t->n_missed = 0;
+	t->jitter_sum_ns = 0;
+	t->jitter_max_ns = 0;
+
+	return true;
+}
+
+void tickerFree( Ticker * t ) {
+	if( t->fd >= 0 ) {
+		close( t->fd );
+	}
+	t->fd = -1;
+}
+
+// Start ticking, with the first tick one period from now.
+bool tickerStart( Ticker * t ) {
+	struct itimerspec spec;
+	spec.it_interval.tv_sec = t->period_ns / 1000000000L;
+	spec.it_interval.tv_nsec = t->period_ns % 1000000000L;
+	spec.it_value = spec.it_interval;
+
+	clock_gettime( CLOCK_MONOTONIC, &t->start );
+	if( timerfd_settime( t->fd, 0, &spec, NULL ) != 0 ) {
+		errLog( "tickerStart(): timerfd_settime() failed." );
+		return false;
+	}
+	t->due = 0;
+	t->running = true;
+	return true;
+}
+
+// Stop ticking. poll() will no longer wake up for this ticker.
+void tickerStop( Ticker * t ) {
+	struct itimerspec spec;
+	memset( &spec, 0, sizeof(spec) );
+	timerfd_settime( t->fd, 0, &spec, NULL );
+	t->running = false;
+}
+
+/* Collect the ticks that have come due. Returns how many periods went by
+   since the last call (usually 1), or 0 if none have. Call when poll()
+   says the ticker's fd is readable. */
+int tickerRead( Ticker * t ) {
+	uint64_t expired;
+	if( read( t->fd, &expired, sizeof(expired) ) != sizeof(expired) || expired == 0 ) {
+		return 0;
+	}
+
+	// How long after its scheduled time the latest tick is being handled.
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	t->due += expired;
+	long long late = timespecDiffNs( &now, &t->start ) - (long long)t->due * t->period_ns;
+	if( late < 0 ) {
+		late = 0;
+	}
+
+	t->n_ticks++;
+	t->n_missed += expired - 1;
+	t->jitter_sum_ns += late;
+	if( late > t->jitter_max_ns ) {
+		t->jitter_max_ns = late;
+	}
+
+	return expired > INT32_MAX ? INT32_MAX : (int)expired;
+}
+
+void tickerLogStats( Ticker * t ) {
+	if( t->n_ticks == 0 ) {
+		return;
+	}
+	errInfo( "Ticks: %llu at %ld ms, %llu missed. Jitter: mean %lld us, max %lld us.",
+		(unsigned long long)t->n_ticks, t->period_ns / 1000000L, (unsigned long long)t->n_missed,
+		t->jitter_sum_ns / (long long)t->n_ticks / 1000, t->jitter_max_ns / 1000 );
+}
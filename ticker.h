@@ -0,0 +1,44 @@
+#ifndef TICKER_H
+#define TICKER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "error_handler.h"
+
+
+/* Fixed-rate tick source for the main loop, built on a timerfd so that it
+   can sit in the same poll() as the keyboard. Ticks come at a steady period
+   however many keys are pressed in between, and a stopped ticker (paused,
+   game over) leaves poll() asleep until a key arrives.
+
+   tickerRead() reports how many periods have gone by since the last read,
+   and keeps track of how late each tick was noticed (jitter) against where
+   it should have fallen on the schedule set by tickerStart(). */
+
+typedef struct Ticker_t {
+	int fd;
+	long period_ns;
+	bool running;
+
+	struct timespec start;	// When the current run of ticks was scheduled from.
+	uint64_t due;			// Ticks due since start.
+
+	// Statistics, over every run since tickerInit().
+	uint64_t n_ticks;
+	uint64_t n_missed;		// Periods that went by while a tick was still outstanding.
+	long long jitter_sum_ns;
+	long long jitter_max_ns;
+} Ticker;
+
+bool tickerInit( Ticker * t, long period_ms );
+void tickerFree( Ticker * t );
+bool tickerStart( Ticker * t );
+void tickerStop( Ticker * t );
+int tickerRead( Ticker * t );
+void tickerLogStats( Ticker * t );
+
+#endif
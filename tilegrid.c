@@ -0,0 +1,344 @@
+#include "tilegrid.h"
+
+// A new tile with one reference, cells and extra bytes not set.
+static uint32_t * tileAlloc( TileGrid * g ) {
+	uint32_t * base = malloc( sizeof(uint32_t) * ( TILE_HEADER_WORDS + TILE_CELLS ) + g->extra );
+	if( !base ) {
+		return NULL;
+	}
+	uint32_t * tile = base + TILE_HEADER_WORDS;
+	gridTileRefs( tile ) = 1;
+	return tile;
+}
+
+static void tileUnref( uint32_t * tile ) {
+	if( --gridTileRefs( tile ) == 0 ) {
+		free( tile - TILE_HEADER_WORDS );
+	}
+}
+
+// Pointers in node i of a level. Only the last node of a level can be short; the directory is never cut.
+static int nodeLength( TileGrid * g, int level, int i ) {
+	int n = g->tw * g->th;
+	int l;
+	for( l = 0; l < level; l++ ) {
+		n = ( n + TILE_NODE_MASK ) >> TILE_NODE_SHIFT;
+	}
+	if( level == TILE_LEVELS - 1 ) {
+		return n;
+	}
+	n -= i << TILE_NODE_SHIFT;
+	return n < TILE_NODE ? n : TILE_NODE;
+}
+
+// A new node with one reference, pointers and slot extras not set.
+static TileNode * nodeAlloc( TileGrid * g, int level, int len ) {
+	TileNode * node = malloc( sizeof(TileNode) + ( sizeof(void *) + g->slot_extra ) * (size_t)len );
+	if( !node ) {
+		return NULL;
+	}
+	node->refs = 1;
+	node->level = level;
+	node->len = len;
+	return node;
+}
+
+// Drop a hold on a node, and on what it points to if nothing else holds it.
+static void nodeUnref( TileGrid * g, TileNode * node ) {
+	if( --node->refs > 0 ) {
+		return;
+	}
+	int i;
+	for( i = 0; i < node->len; i++ ) {
+		if( node->level > 0 ) {
+			nodeUnref( g, node->kids[i] );
+		}
+		else if( node->kids[i] != g->blank ) {
+			tileUnref( node->kids[i] );
+		}
+	}
+	free( node );
+}
+
+/* Node i of a level, for an all-blank grid: every tile pointer set to
+   'blank'. NULL if out of memory, with nothing left allocated. */
+static TileNode * nodeBuild( TileGrid * g, int level, int i, uint32_t * blank ) {
+	TileNode * node = nodeAlloc( g, level, nodeLength( g, level, i ) );
+	if( !node ) {
+		return NULL;
+	}
+	int k;
+	for( k = 0; k < node->len; k++ ) {
+		if( level == 0 ) {
+			node->kids[k] = blank;
+			continue;
+		}
+		node->kids[k] = nodeBuild( g, level - 1, ( i << TILE_NODE_SHIFT ) + k, blank );
+		if( !node->kids[k] ) {
+			node->len = k;
+			nodeUnref( g, node );
+			return NULL;
+		}
+	}
+	return node;
+}
+
+/* A copy of a shared node, pointers and slot extras and all, for a grid to
+   change; it takes the place of the grid's hold on the old node. What it
+   points to stays shared, so each gains a reference. Costs the node's
+   length, not the grid's. */
+static TileNode * nodeCopy( TileGrid * g, TileNode * old ) {
+	TileNode * node = nodeAlloc( g, old->level, old->len );
+	if( !node ) {
+		errLog( "nodeCopy(): malloc() failed on a node of %d pointers.", old->len );
+		return NULL;
+	}
+	memcpy( node->kids, old->kids, ( sizeof(void *) + g->slot_extra ) * (size_t)old->len );
+	int i;
+	for( i = 0; i < node->len; i++ ) {
+		if( node->level > 0 ) {
+			( (TileNode *)node->kids[i] )->refs++;
+		}
+		else if( node->kids[i] != g->blank ) {
+			gridTileRefs( (uint32_t *)node->kids[i] )++;
+		}
+	}
+	old->refs--;
+	return node;
+}
+
+bool gridInit( TileGrid * g, int w, int h, uint32_t fill ) {
+	return gridInitExtra( g, w, h, fill, 0, 0 );
+}
+
+bool gridInitExtra( TileGrid * g, int w, int h, uint32_t fill, int extra, int slot_extra ) {
+	if( w < 1 || h < 1 || extra < 0 || slot_extra < 0 ) {
+		errLog( "gridInit(): invalid dimensions (w%d h%d extra %d/%d).", w, h, extra, slot_extra );
+		return false;
+	}
+
+	g->w = w;
+	g->h = h;
+	g->tw = ( w + TILE_MASK ) >> TILE_SHIFT;
+	g->th = ( h + TILE_MASK ) >> TILE_SHIFT;
+	g->n_tiles = 0;
+	g->extra = extra;
+	g->slot_extra = slot_extra;
+	g->dir = NULL;
+	g->groups = NULL;
+
+	if( g->tw > INT_MAX / g->th ) {
+		errLog( "gridInit(): %dx%d needs too many tiles.", w, h );
+		return false;
+	}
+
+	g->blank = tileAlloc( g );
+	if( !g->blank ) {
+		errLog( "gridInit(): malloc() failed on a %dx%d grid.", w, h );
+		return false;
+	}
+	memset( g->blank + TILE_CELLS, 0, extra );
+
+	g->fill = ~fill;	// Make sure gridClear() fills the blank tile.
+	if( !gridClear( g, fill ) ) {
+		tileUnref( g->blank );
+		g->blank = NULL;
+		return false;
+	}
+	return true;
+}
+
+// Make 'dst' a copy of 'src', sharing all of its memory until either one is written to.
+// 'dst' must not be set up already.
+bool gridCopy( TileGrid * dst, TileGrid * src ) {
+	*dst = *src;
+	dst->dir->refs++;
+	gridTileRefs( dst->blank )++;
+	return true;
+}
+
+void gridFree( TileGrid * g ) {
+	if( g->dir ) {
+		nodeUnref( g, g->dir );
+	}
+	if( g->blank ) {
+		tileUnref( g->blank );
+	}
+	g->dir = NULL;
+	g->groups = NULL;
+	g->blank = NULL;
+	g->n_tiles = 0;
+}
+
+/* Give this grid its own copy of every node on the way to tile t, so that
+   tile t's pointer, and the slot extras along the way, can change. */
+static bool gridOwnPath( TileGrid * g, int t ) {
+	if( g->dir->refs > 1 ) {
+		TileNode * dir = nodeCopy( g, g->dir );
+		if( !dir ) {
+			return false;
+		}
+		g->dir = dir;
+		g->groups = dir->kids;
+	}
+
+	TileNode * node = g->dir;
+	int level;
+	for( level = TILE_LEVELS - 1; level > 0; level-- ) {
+		int slot = t >> ( level * TILE_NODE_SHIFT );
+		if( level < TILE_LEVELS - 1 ) {
+			slot &= TILE_NODE_MASK;
+		}
+		TileNode * kid = node->kids[slot];
+		if( kid->refs > 1 ) {
+			kid = nodeCopy( g, kid );
+			if( !kid ) {
+				return false;
+			}
+			node->kids[slot] = kid;
+		}
+		node = kid;
+	}
+	return true;
+}
+
+/* Give every tile back, leaving the whole grid set to 'fill'. Returns false,
+   with the grid as it was, if there is no memory for the new nodes. */
+bool gridClear( TileGrid * g, uint32_t fill ) {
+	uint32_t * blank = g->blank;
+	if( fill != g->fill && gridTileRefs( blank ) > 1 ) {
+		blank = tileAlloc( g );
+		if( !blank ) {
+			errLog( "gridClear(): malloc() failed on the blank tile." );
+			return false;
+		}
+		memset( blank + TILE_CELLS, 0, g->extra );
+	}
+
+	// None of the old pointers are needed, so every node starts afresh.
+	TileNode * dir = nodeBuild( g, TILE_LEVELS - 1, 0, blank );
+	if( !dir ) {
+		errLog( "gridClear(): malloc() failed on a %dx%d grid.", g->w, g->h );
+		if( blank != g->blank ) {
+			tileUnref( blank );
+		}
+		return false;
+	}
+
+	if( g->dir ) {
+		nodeUnref( g, g->dir );
+	}
+	if( blank != g->blank ) {
+		tileUnref( g->blank );
+		g->blank = blank;
+	}
+	if( fill != g->fill ) {
+		int i;
+		for( i = 0; i < TILE_CELLS; i++ ) {
+			g->blank[i] = fill;
+		}
+		g->fill = fill;
+	}
+
+	g->dir = dir;
+	g->groups = dir->kids;
+	g->n_tiles = 0;
+	return true;
+}
+
+// Whether tile t can be written as it is: it has memory, and nothing on the way to it is shared.
+static bool gridTileOwned( TileGrid * g, int t ) {
+	TileNode * group = gridGroup( g, t );
+	TileNode * chunk = gridChunk( g, t );
+	uint32_t * tile = gridTile( g, t );
+	return tile != g->blank && gridTileRefs( tile ) == 1 && chunk->refs == 1 && group->refs == 1 && g->dir->refs == 1;
+}
+
+/* Give tile t memory that only this grid uses, so that it can be written:
+   a copy of the blank tile, or of the tile shared with another grid. */
+static uint32_t * gridOwnTile( TileGrid * g, int t ) {
+	if( gridTileOwned( g, t ) ) {
+		return gridTile( g, t );
+	}
+	if( !gridOwnPath( g, t ) ) {
+		return NULL;
+	}
+	uint32_t * old = gridTile( g, t );
+	if( old != g->blank && gridTileRefs( old ) == 1 ) {
+		return old;
+	}
+
+	uint32_t * tile = tileAlloc( g );
+	if( !tile ) {
+		errLog( "gridOwnTile(): malloc() failed on tile %d.", t );
+		return NULL;
+	}
+	memcpy( tile, old, sizeof(uint32_t) * TILE_CELLS + g->extra );
+	if( old == g->blank ) {
+		g->n_tiles++;
+	}
+	else {
+		tileUnref( old );
+	}
+	gridChunk( g, t )->kids[ t & TILE_NODE_MASK ] = tile;
+	return tile;
+}
+
+// Point tile t back at the blank tile. The caller knows it holds nothing else.
+void gridRelease( TileGrid * g, int t ) {
+	if( gridTileBlank( g, t ) ) {
+		return;
+	}
+	// Failing to get the nodes only means the tile is kept for now.
+	if( !gridOwnPath( g, t ) ) {
+		return;
+	}
+	tileUnref( gridTile( g, t ) );
+	gridChunk( g, t )->kids[ t & TILE_NODE_MASK ] = g->blank;
+	g->n_tiles--;
+}
+
+// Set the cell at x,y. Writing the fill value to a blank tile costs nothing.
+// Returns false if a tile was needed and could not be allocated.
+bool gridPut( TileGrid * g, int x, int y, uint32_t value ) {
+	int t = gridTileIndex( g, x, y );
+	uint32_t * tile = gridTile( g, t );
+	if( tile == g->blank && value == g->fill ) {
+		return true;
+	}
+	if( !gridTileOwned( g, t ) ) {
+		tile = gridOwnTile( g, t );
+		if( !tile ) {
+			return false;
+		}
+	}
+	tile[ gridCellIndex( x, y ) ] = value;
+	return true;
+}
+
+// Number of cells from x to the end of its tile row, or of the grid row.
+static int gridSpanLength( TileGrid * g, int x ) {
+	int n = TILE_SIZE - ( x & TILE_MASK );
+	if( x + n > g->w ) {
+		n = g->w - x;
+	}
+	return n;
+}
+
+/* The run of cells on row y starting at x, up to the edge of its tile (or of
+   the grid). Sets *n to its length. For reading only: it may be the blank
+   tile, or shared with another grid. */
+const uint32_t * gridSpan( TileGrid * g, int x, int y, int * n ) {
+	*n = gridSpanLength( g, x );
+	return &gridAt( g, x, y );
+}
+
+// As gridSpan(), but the run may be written to. Returns NULL if a tile was needed and could not be allocated.
+uint32_t * gridSpanW( TileGrid * g, int x, int y, int * n ) {
+	*n = gridSpanLength( g, x );
+	uint32_t * tile = gridOwnTile( g, gridTileIndex( g, x, y ) );
+	if( !tile ) {
+		return NULL;
+	}
+	return tile + gridCellIndex( x, y );
+}
@@ -0,0 +1,118 @@
+#ifndef TILEGRID_H
+#define TILEGRID_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "error_handler.h"
+
+
+/* A w x h grid of 32-bit values, stored as square tiles of TILE_SIZE x
+   TILE_SIZE cells rather than in one block. Every tile starts out pointing at
+   a single shared 'blank' tile filled with the grid's fill value, and only
+   gets memory of its own the first time a different value is written to it,
+   so memory follows the part of the grid that has actually been used, not
+   its nominal size. Reads never allocate.
+
+   Within a tile, cells are stored row by row, so a run of cells along a row
+   is contiguous up to the tile's right edge. gridSpan() and gridSpanW() hand
+   out those runs for code that works a row at a time.
+
+   The tile pointers are kept in a small tree of nodes: chunks of
+   TILE_NODE tile pointers, groups of TILE_NODE chunk pointers, and a
+   directory of the groups. gridTile() follows all three.
+
+   Grids can share memory. gridCopy() makes a copy in constant time: the two
+   grids share the whole tree and every tile, and whichever one writes first
+   gets its own copy of each node on the way to the tile, and of the tile
+   (copy on write). Every node and every tile, the blank one included,
+   carries a reference count for this. So the first write after a copy costs
+   a directory (a pointer per TILE_NODE * TILE_NODE tiles), a group, a chunk
+   and a tile, however big the grid is. The counts are not atomic, so grids
+   that share memory must stay on one thread.
+
+   A grid can also ask for 'extra' bytes after the cells of every tile it
+   owns, and 'slot_extra' bytes for every pointer in every node
+   (gridInitExtra()). They are copied along with the tile or node, and are
+   for the grid's user to keep per-tile data and running totals in; see
+   gridTileExtra() and gridNodeExtra(). gridClear() leaves them unset.
+
+   Used by both the Arena and the Board. */
+
+#define TILE_SHIFT 6
+#define TILE_SIZE (1 << TILE_SHIFT)
+#define TILE_MASK (TILE_SIZE - 1)
+#define TILE_CELLS (TILE_SIZE * TILE_SIZE)
+
+#define TILE_NODE_SHIFT 8
+#define TILE_NODE (1 << TILE_NODE_SHIFT)
+#define TILE_NODE_MASK (TILE_NODE - 1)
+#define TILE_LEVELS 3		// Chunks, groups and the directory.
+
+/* A chunk (level 0: pointers to tiles), a group (level 1: pointers to
+   chunks) or the directory (level 2: pointers to groups). Shared between
+   copies of a grid until one of them changes a pointer. 'len' pointers,
+   TILE_NODE at most except in the directory, are followed by their slot
+   extras. */
+typedef struct TileNode_t {
+	int refs;
+	int level;
+	int len;
+	void * kids[];
+} TileNode;
+
+typedef struct TileGrid_t {
+	int w;
+	int h;
+	int tw;				// Size in tiles.
+	int th;
+	TileNode * dir;
+	void ** groups;		// dir->kids. Tiles go row by row.
+	uint32_t * blank;	// The blank tile. Never written while it is shared.
+	uint32_t fill;		// Value of every cell in the blank tile.
+	int n_tiles;		// Tiles with memory of their own, shared or not.
+	int extra;			// Bytes of user data after the cells of each tile.
+	int slot_extra;		// Bytes of user data per pointer in each node.
+} TileGrid;
+
+// Words in front of every tile's cells. The one just before the first cell is the reference count.
+#define TILE_HEADER_WORDS 2
+#define gridTileRefs( tile ) ( (tile)[-1] )
+
+// The group and the chunk that hold tile t's pointer, and tile t's cells.
+#define gridGroup( g, t ) ( (TileNode *)(g)->groups[ (t) >> ( 2 * TILE_NODE_SHIFT ) ] )
+#define gridChunk( g, t ) ( (TileNode *)gridGroup( g, t )->kids[ ( (t) >> TILE_NODE_SHIFT ) & TILE_NODE_MASK ] )
+#define gridTile( g, t ) ( (uint32_t *)gridChunk( g, t )->kids[ (t) & TILE_NODE_MASK ] )
+
+// The slot extras of a node, slot_extra bytes for each of its pointers in turn.
+// Only to be written just after gridClear(), or after a write to a tile under the node, which
+// gives the grid its own copy of every node on the way to the tile.
+#define gridNodeExtra( node ) ( (void *)( (node)->kids + (node)->len ) )
+
+// The extra bytes of tile t. Only meaningful once the tile has memory of its own.
+#define gridTileExtra( g, t ) ( (void *)( gridTile( g, t ) + TILE_CELLS ) )
+
+// Tile that holds cell x,y, and where the cell sits in it.
+#define gridTileIndex( g, x, y ) ( ( (y) >> TILE_SHIFT ) * (g)->tw + ( (x) >> TILE_SHIFT ) )
+#define gridCellIndex( x, y ) ( ( ( (y) & TILE_MASK ) << TILE_SHIFT ) | ( (x) & TILE_MASK ) )
+
+// Value at x,y. No bounds checking.
+#define gridAt( g, x, y ) ( gridTile( g, gridTileIndex( g, x, y ) )[ gridCellIndex( x, y ) ] )
+
+// Whether tile t is still the shared blank tile.
+#define gridTileBlank( g, t ) ( gridTile( g, t ) == (g)->blank )
+
+bool gridInit( TileGrid * g, int w, int h, uint32_t fill );
+bool gridInitExtra( TileGrid * g, int w, int h, uint32_t fill, int extra, int slot_extra );
+bool gridCopy( TileGrid * dst, TileGrid * src );
+void gridFree( TileGrid * g );
+bool gridClear( TileGrid * g, uint32_t fill );
+bool gridPut( TileGrid * g, int x, int y, uint32_t value );
+const uint32_t * gridSpan( TileGrid * g, int x, int y, int * n );
+uint32_t * gridSpanW( TileGrid * g, int x, int y, int * n );
+void gridRelease( TileGrid * g, int t );
+
+#endif